@@ -9,6 +9,7 @@
 #include <string.h>
 #include "hde32.h"
 #include "table32.h"
+#include "tablelen32.h"
 
 #ifdef _MSC_VER
 #pragma warning(disable:4701)
@@ -336,4 +337,45 @@ disasm_done:
 	}
 
 	return (unsigned int)hs->len;
-}
\ No newline at end of file
+}
+
+unsigned int hde32_length(const void *code)
+{
+	const uint8_t *p = (const uint8_t*)code;
+	unsigned int index = 0, reg;
+	uint8_t op, c, m, t;
+	hde32s hs;
+
+	if (*p == 0x66) {
+		index = 0x100;
+		p++;
+	}
+	if (*p == 0x0f) {
+		index |= 0x200;
+		p++;
+	}
+
+	op = *p++;
+	c = hde32_length_table[index | op];
+	if (c == L_SLOW)
+		goto slow;
+
+	if (c & L_MODRM) {
+		m = *p++;
+		t = hde32_modrm_table[m];
+		reg = (m >> 3) & 7;
+
+		if ((hde32_length_errors[index | op] >> (reg + (m >= 0xc0) * 8)) & 1)
+			return 0;
+		if ((c & L_TEST) && reg > 1)
+			c &= ~L_IMM;
+
+		p += (t & M_SIZE) + ((((t & M_SIB) >> 3) & ((*p & 7) == 5)) << 2);
+	}
+
+	return (unsigned int)(p + (c & L_IMM) - (const uint8_t*)code);
+
+slow:
+	hde32_disasm(code, &hs);
+	return (hs.flags & F_ERROR) ? 0 : hs.len;
+}
@@ -89,6 +89,9 @@ extern "C" {
 	/* __cdecl */
 	unsigned int hde32_disasm(const void *code, hde32s *hs);
 
+	/* Length of the instruction, 0 if it's invalid. */
+	unsigned int hde32_length(const void *code);
+
 #ifdef __cplusplus
 }
 #endif
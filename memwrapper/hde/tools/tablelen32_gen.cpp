@@ -0,0 +1,232 @@
+﻿/*
+ * Hacker Disassembler Engine 32 C
+ * Copyright (c) 2008-2009, Vyacheslav Patkov.
+ * All rights reserved.
+ *
+ * tablelen32_gen.cpp: generates tablelen32.h by probing hde32_disasm.
+ * Regenerate whenever hde32_disasm or table32.h changes:
+ *
+ *   g++ -O2 -I.. tablelen32_gen.cpp ../hde32.cpp -o tablelen32_gen
+ *   ./tablelen32_gen > ../tablelen32.h
+ *
+ * then rebuild and run tablelen32_test.cpp.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "hde32.h"
+#include "tablelen32.h"
+
+static uint8_t length_table[0x400];
+static uint16_t length_errors[0x400];
+static uint8_t modrm_table[0x100];
+
+/* Length of code as hde32_length sees it, 0 if it's invalid. */
+static unsigned int probe(const uint8_t *code)
+{
+	hde32s hs;
+
+	hde32_disasm(code, &hs);
+	return (hs.flags & F_ERROR) ? 0 : hs.len;
+}
+
+static int is_prefix(uint8_t c)
+{
+	switch (c) {
+	case 0xf0: case 0xf2: case 0xf3:
+	case 0x26: case 0x2e: case 0x36:
+	case 0x3e: case 0x64: case 0x65:
+	case 0x66: case 0x67:
+		return 1;
+	}
+	return 0;
+}
+
+/* Size of sib and displacement after modrm, from mov r32, r/m32. */
+static void make_modrm_table(void)
+{
+	uint8_t code[16] = { 0x8b };
+	unsigned int m, len, t;
+
+	for (m = 0; m < 0x100; m++) {
+		code[1] = (uint8_t)m;
+		code[2] = 0;
+		len = probe(code);
+		t = len - 2;
+		code[2] = 5;
+		if (probe(code) != len)
+			t |= M_SIB;
+		modrm_table[m] = (uint8_t)t;
+	}
+}
+
+/* Fast path entry for one opcode, L_SLOW if it can't describe it. */
+static void make_entry(unsigned int index)
+{
+	uint8_t code[16] = { 0 }, op = (uint8_t)index;
+	unsigned int pre = 0, m, s, len, imm, reg, bit, t, size;
+	unsigned int seen = 0, errors = 0, has_imm = 0, imm_reg[2] = { 0 };
+	uint8_t c = 0;
+	hde32s hs;
+
+	length_table[index] = L_SLOW;
+	if (is_prefix(op) && !(index & 0x200))
+		return;
+	if (op == 0x0f && !(index & 0x200))
+		return;
+
+	if (index & 0x100)
+		code[pre++] = 0x66;
+	if (index & 0x200)
+		code[pre++] = 0x0f;
+	code[pre] = op;
+
+	hde32_disasm(code, &hs);
+	if (!(hs.flags & F_MODRM)) {
+		if (hs.flags & F_ERROR)
+			return;
+		imm = hs.len - pre - 1;
+		for (m = 0; m < 0x100; m++) {
+			code[pre + 1] = (uint8_t)m;
+			if (probe(code) != pre + 1 + imm)
+				return;
+		}
+		length_table[index] = (uint8_t)imm;
+		return;
+	}
+
+	/* Register fields that are invalid for every rm and sib. */
+	for (m = 0; m < 0x100; m++) {
+		bit = 1u << (((m >> 3) & 7) + (m >= 0xc0) * 8);
+		code[pre + 1] = (uint8_t)m;
+		for (s = 0; s < 0x100; s++) {
+			code[pre + 2] = (uint8_t)s;
+			t = probe(code) ? 0 : bit;
+			if (!(seen & bit))
+				errors |= t;
+			else if ((errors & bit) != t)
+				return;
+			seen |= bit;
+		}
+	}
+	if (errors == 0xffff)	/* Invalid anyway, leave it to hde32_disasm. */
+		return;
+
+	/* Immediate size, for f6 and f7 only with reg 0 and 1. */
+	for (m = 0; m < 0x100; m++) {
+		reg = (m >> 3) & 7;
+		bit = 1u << (reg + (m >= 0xc0) * 8);
+		if (errors & bit)
+			continue;
+		code[pre + 1] = (uint8_t)m;
+		code[pre + 2] = 0;
+		imm = probe(code) - pre - 2 - (modrm_table[m] & M_SIZE);
+		t = reg > 1;
+		if (has_imm & (1u << t) && imm != imm_reg[t])
+			return;
+		imm_reg[t] = imm;
+		has_imm |= 1u << t;
+	}
+	if (has_imm == 3 && imm_reg[0] != imm_reg[1]) {
+		if (imm_reg[1])
+			return;
+		c = L_TEST;
+	}
+	c |= L_MODRM | (has_imm & 1 ? imm_reg[0] : imm_reg[1]);
+
+	/* Every valid rm and sib must give hde32_disasm's length. */
+	for (m = 0; m < 0x100; m++) {
+		reg = (m >> 3) & 7;
+		bit = 1u << (reg + (m >= 0xc0) * 8);
+		if (errors & bit)
+			continue;
+		t = modrm_table[m];
+		code[pre + 1] = (uint8_t)m;
+		for (s = 0; s < 0x100; s++) {
+			code[pre + 2] = (uint8_t)s;
+			size = (t & M_SIZE) +
+				((((t & M_SIB) >> 3) & ((s & 7) == 5)) << 2);
+			imm = ((c & L_TEST) && reg > 1) ? 0 : (c & L_IMM);
+			len = probe(code);
+			if (len != pre + 2 + size + imm)
+				return;
+		}
+	}
+
+	length_table[index] = c;
+	length_errors[index] = (uint16_t)errors;
+}
+
+static void print_table(const char *type, const char *name,
+	const void *table, unsigned int count, unsigned int width)
+{
+	unsigned int i, per_line = width == 1 ? 15 : 10;
+
+	printf("static const %s %s[] = {\r\n", type, name);
+	for (i = 0; i < count; i++) {
+		if (i % per_line == 0)
+			printf("  ");
+		if (width == 1)
+			printf("0x%02x", ((const uint8_t*)table)[i]);
+		else
+			printf("0x%04x", ((const uint16_t*)table)[i]);
+		if (i + 1 == count)
+			printf("\r\n");
+		else if (i % per_line == per_line - 1)
+			printf(",\r\n");
+		else
+			printf(",");
+	}
+	printf("};\r\n");
+}
+
+int main(void)
+{
+	unsigned int index;
+
+	make_modrm_table();
+	for (index = 0; index < 0x400; index++)
+		make_entry(index);
+
+	printf("\xef\xbb\xbf/*\r\n"
+		" * Hacker Disassembler Engine 32 C\r\n"
+		" * Copyright (c) 2008-2009, Vyacheslav Patkov.\r\n"
+		" * All rights reserved.\r\n"
+		" *\r\n"
+		" * tablelen32.h: tables of hde32_length, generated by probing"
+		" hde32_disasm\r\n"
+		" * with every modrm and sib byte. Index: (0x0f escape << 9) |"
+		" (0x66 prefix\r\n"
+		" * << 8) | opcode.\r\n"
+		" *\r\n"
+		" * Regenerate with tools/tablelen32_gen.cpp and check with\r\n"
+		" * tools/tablelen32_test.cpp.\r\n"
+		" *\r\n"
+		" */\r\n"
+		"\r\n"
+		"#define L_IMM     0x0f\r\n"
+		"#define L_TEST    0x40\r\n"
+		"#define L_MODRM   0x80\r\n"
+		"#define L_SLOW    0xff\r\n"
+		"\r\n"
+		"#define M_SIZE    0x07\r\n"
+		"#define M_SIB     0x08\r\n"
+		"\r\n"
+		"/* L_MODRM: has modrm, L_TEST: immediate only for reg 0 and 1"
+		" (f6, f7),\r\n"
+		"   L_IMM: size of immediates, L_SLOW: decoded by"
+		" hde32_disasm. */\r\n");
+	print_table("uint8_t", "hde32_length_table", length_table, 0x400, 1);
+	printf("\r\n"
+		"/* Registers of the modrm reg field that are invalid, low byte"
+		" for memory\r\n"
+		"   operands, high byte for register operands. */\r\n");
+	print_table("uint16_t", "hde32_length_errors", length_errors, 0x400, 2);
+	printf("\r\n"
+		"/* M_SIZE: size of sib and displacement, M_SIB: sib with base 5"
+		" adds\r\n"
+		"   disp32. */\r\n");
+	print_table("uint8_t", "hde32_modrm_table", modrm_table, 0x100, 1);
+	return 0;
+}
@@ -0,0 +1,89 @@
+﻿/*
+ * Hacker Disassembler Engine 32 C
+ * Copyright (c) 2008-2009, Vyacheslav Patkov.
+ * All rights reserved.
+ *
+ * tablelen32_test.cpp: differential test of hde32_length against
+ * hde32_disasm. Every opcode, with and without 0x66 and 0x0f, is checked
+ * with every modrm and sib byte, then random code with random prefixes.
+ *
+ *   g++ -O2 -I.. tablelen32_test.cpp ../hde32.cpp -o tablelen32_test
+ *   ./tablelen32_test
+ *
+ * Exits with 1 and prints the first mismatches if the tables are stale.
+ *
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "hde32.h"
+
+static const uint8_t prefixes[] = {
+	0xf0, 0xf2, 0xf3, 0x26, 0x2e, 0x36, 0x3e, 0x64, 0x65, 0x66, 0x67, 0x0f
+};
+
+static unsigned long count, mismatches;
+static uint32_t seed = 1;
+
+/* xorshift32, so runs are repeatable on every compiler. */
+static uint8_t next_byte(void)
+{
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return (uint8_t)seed;
+}
+
+static void check(const uint8_t *code)
+{
+	hde32s hs;
+	unsigned int expected, actual, i;
+
+	hde32_disasm(code, &hs);
+	expected = (hs.flags & F_ERROR) ? 0 : hs.len;
+	actual = hde32_length(code);
+	count++;
+	if (expected == actual)
+		return;
+	if (mismatches++ < 16) {
+		printf("hde32_disasm %u, hde32_length %u:", expected, actual);
+		for (i = 0; i < 16; i++)
+			printf(" %02x", code[i]);
+		printf("\n");
+	}
+}
+
+int main(void)
+{
+	uint8_t code[32];
+	unsigned int index, pre, m, s, i, n;
+
+	for (index = 0; index < 0x400; index++) {
+		for (i = 0; i < sizeof(code); i++)
+			code[i] = next_byte();
+		pre = 0;
+		if (index & 0x100)
+			code[pre++] = 0x66;
+		if (index & 0x200)
+			code[pre++] = 0x0f;
+		code[pre] = (uint8_t)index;
+		for (m = 0; m < 0x100; m++) {
+			code[pre + 1] = (uint8_t)m;
+			for (s = 0; s < 0x100; s++) {
+				code[pre + 2] = (uint8_t)s;
+				check(code);
+			}
+		}
+	}
+
+	for (n = 0; n < 8000000; n++) {
+		for (i = 0; i < sizeof(code); i++)
+			code[i] = next_byte();
+		for (i = 0, pre = next_byte() % 4; i < pre; i++)
+			code[i] = prefixes[next_byte() % sizeof(prefixes)];
+		check(code);
+	}
+
+	printf("%lu inputs, %lu mismatches\n", count, mismatches);
+	return mismatches ? 1 : 0;
+}
@@ -32,15 +32,51 @@
 #include <string>
 #include <vector>
 #include <type_traits>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <functional>
+#include <thread>
+#include <condition_variable>
+#include <cctype>
+#include <unordered_map>
+#include <emmintrin.h>
 
 #if defined(MW_WIN_X86)
 #include "hde/hde32.h"
 
 #include "x86/memwrapper_basic.hpp"
+#include "x86/memwrapper_ownership.hpp"
 #include "x86/memwrapper_llmo.hpp"
 #include "x86/memwrapper_detail.hpp"
 #include "x86/memwrapper_allocator.hpp"
 #include "x86/memwrapper_hook.hpp"
+#include "x86/memwrapper_publisher.hpp"
+#include "x86/memwrapper_image.hpp"
+#include "x86/memwrapper_diff.hpp"
+#include "x86/memwrapper_transaction.hpp"
+#include "x86/memwrapper_unhook.hpp"
+#include "x86/memwrapper_bulk.hpp"
+#include "x86/memwrapper_dump.hpp"
+#include "x86/memwrapper_regions.hpp"
+#include "x86/memwrapper_pool.hpp"
+#include "x86/memwrapper_scan.hpp"
+#include "x86/memwrapper_snapshot.hpp"
+#include "x86/memwrapper_xref.hpp"
+#include "x86/memwrapper_instances.hpp"
+#include "x86/memwrapper_static_hook.hpp"
+#include "x86/memwrapper_profile.hpp"
+#include "x86/memwrapper_ab.hpp"
+#include "x86/memwrapper_coverage.hpp"
+#include "x86/memwrapper_breakpoint_hook.hpp"
+#include "x86/memwrapper_unwind.hpp"
+#include "x86/memwrapper_symbols.hpp"
+#include "x86/memwrapper_emulator.hpp"
+#include "x86/memwrapper_invoke.hpp"
+#include "x86/memwrapper_journal.hpp"
+#include "x86/memwrapper_freezer.hpp"
+#include "x86/memwrapper_modules.hpp"
+#include "x86/memwrapper_layout.hpp"
 #endif   // defined(MW_WIN_X86)
 
 #endif   // !MEMWRAPPER_H_
@@ -0,0 +1,485 @@
+﻿#ifndef MEMWRAPPER_AB_HPP_
+#define MEMWRAPPER_AB_HPP_
+
+namespace memwrapper {
+/**
+ * @brief Histogram of frame times with 10 microseconds buckets up to 100 ms.
+ */
+class frame_histogram {
+  public:
+    /**
+     * \brief Number of buckets, the last one holds longer frames.
+     */
+    static constexpr uint32_t kBuckets = 10000u;
+    /**
+     * \brief Width of a bucket in milliseconds.
+     */
+    static constexpr double kBucketWidth = 0.01;
+
+  protected:
+    /**
+     * Counts of frames per bucket.
+     */
+    std::vector<uint32_t> m_buckets;
+    /**
+     * Number of frames.
+     */
+    size_t m_count;
+
+  public:
+    frame_histogram()
+        : m_buckets(kBuckets, 0u)
+        , m_count(0u) {}
+
+    /**
+     * Adds a frame.
+     *
+     * \param milliseconds Frame time.
+     */
+    void add(const double milliseconds) {
+        auto bucket = static_cast<uint32_t>((std::max)(milliseconds, 0.0) /
+                                            kBucketWidth);
+        m_buckets[(std::min)(bucket, kBuckets - 1u)]++;
+        m_count++;
+    }
+
+    /**
+     * \param q Quantile in [0, 1].
+     * \return Frame time of the quantile in milliseconds (middle of bucket).
+     */
+    double quantile(const double q) const {
+        if (!m_count)
+            return 0.0;
+
+        auto   last = static_cast<double>(m_count - 1u);
+        auto   rank = static_cast<size_t>(q * last);
+        size_t seen = 0u;
+
+        for (uint32_t i = 0; i < kBuckets; i++) {
+            seen += m_buckets[i];
+            if (seen > rank)
+                return (i + 0.5) * kBucketWidth;
+        }
+
+        return kBuckets * kBucketWidth;
+    }
+
+    /**
+     * Drops all frames.
+     */
+    void clear() {
+        std::fill(m_buckets.begin(), m_buckets.end(), 0u);
+        m_count = 0u;
+    }
+
+    /**
+     * \return Counts of frames per bucket.
+     */
+    const std::vector<uint32_t>& buckets() const { return m_buckets; }
+    /**
+     * \return Number of frames.
+     */
+    size_t count() const { return m_count; }
+};   // !class frame_histogram
+
+/**
+ * @brief Difference of a frame time statistic (B - A) in milliseconds.
+ */
+struct ab_difference {
+    /**
+     * Observed difference.
+     */
+    double value;
+    /**
+     * Lower bound of the 95% confidence interval.
+     */
+    double low;
+    /**
+     * Upper bound of the 95% confidence interval.
+     */
+    double high;
+};   // !struct ab_difference
+
+/**
+ * @brief Result of an A/B run. Times are in milliseconds.
+ */
+struct ab_report {
+    size_t        samples_a;
+    size_t        samples_b;
+    double        median_a;
+    double        median_b;
+    double        p99_a;
+    double        p99_b;
+    ab_difference median;
+    ab_difference p99;
+    /**
+     * Longest switch between patch sets.
+     */
+    double toggle_max;
+};   // !struct ab_report
+
+namespace detail {
+/**
+ * Draws a bootstrap resample of a histogram.
+ *
+ * \param cumulative Cumulative counts of the histogram.
+ * \param state State of the random generator.
+ * \param out Output histogram.
+ */
+inline void resample_histogram(const std::vector<size_t>& cumulative,
+                               uint64_t& state, frame_histogram& out) {
+    out.clear();
+
+    auto total = cumulative.back();
+    for (size_t i = 0; i < total; i++) {
+        // xorshift64
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        auto pick   = state % total;
+        auto bucket = std::upper_bound(cumulative.begin(), cumulative.end(),
+                                       pick) -
+                      cumulative.begin();
+
+        out.add((bucket + 0.5) * frame_histogram::kBucketWidth);
+    }
+}
+}   // namespace detail
+
+/**
+ * @brief A/B harness for patch sets.
+ *
+ * \c tick() \c is called once per frame from a hook of the frame function.
+ * Every \c period \c ticks the harness switches between patch sets A and B
+ * with one \c write_transaction \c (kept between switches, so a switch
+ * doesn't allocate), the first \c warmup \c frames after a switch are
+ * discarded. Patches of A and B must not overlap.
+ *
+ * @code{.cpp}
+ * memwrapper::ab_harness harness{ 120, 10 };
+ * harness.add_b(0x00401000, { 0x90, 0x90 });
+ * harness.start();
+ *
+ * // in the hook of the frame function
+ * harness.tick();
+ *
+ * auto report = harness.report();
+ * @endcode
+ */
+class ab_harness {
+    struct patch {
+        uintptr_t            address;
+        std::vector<uint8_t> bytes;
+    };
+
+  protected:
+    /**
+     * Patches of both arms.
+     */
+    std::vector<patch> m_arms[2];
+    /**
+     * Writes that switch to each arm.
+     */
+    std::vector<patch> m_switches[2];
+    /**
+     * Original bytes of patched ranges.
+     */
+    std::vector<patch> m_originals;
+    /**
+     * Writes of a switch, keeps its buffers between switches.
+     */
+    write_transaction m_transaction;
+    /**
+     * Frame times of both arms.
+     */
+    frame_histogram m_histograms[2];
+    /**
+     * Guards the histograms and the longest switch.
+     */
+    mutable std::mutex m_mutex;
+    /**
+     * Ticks per arm.
+     */
+    uint32_t m_period;
+    /**
+     * Discarded ticks after a switch.
+     */
+    uint32_t m_warmup;
+    /**
+     * Active arm.
+     */
+    uint32_t m_arm;
+    /**
+     * Ticks since the last switch.
+     */
+    uint32_t m_ticks;
+    /**
+     * QPC of the last tick.
+     */
+    int64_t m_last;
+    /**
+     * QPC frequency in ticks per millisecond.
+     */
+    double m_frequency;
+    /**
+     * Longest switch in QPC ticks.
+     */
+    int64_t m_toggle_max;
+    /**
+     * Is harness running.
+     */
+    bool m_running;
+
+  public:
+    ab_harness(const ab_harness&) = delete;
+    ab_harness(ab_harness&&)      = delete;
+
+    /**
+     * Constructor.
+     *
+     * \param period Ticks per arm.
+     * \param warmup Discarded ticks after a switch.
+     */
+    ab_harness(const uint32_t period = 120u, const uint32_t warmup = 10u)
+        : m_period((std::max)(period, 1u))
+        , m_warmup(warmup)
+        , m_arm(0u)
+        , m_ticks(0u)
+        , m_last(0)
+        , m_toggle_max(0)
+        , m_running(false) {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        m_frequency = static_cast<double>(frequency.QuadPart) / 1000.0;
+    }
+
+    /**
+     * Destructor. Restores the original code.
+     */
+    ~ab_harness() { stop(); }
+
+    /**
+     * Adds a patch of arm A.
+     *
+     * \param at Destination.
+     * \param bytes Bytes that will be written.
+     */
+    void add_a(const memory_pointer& at, const std::vector<uint8_t>& bytes) {
+        if (!m_running)
+            m_arms[0].push_back({ at.addressof(), bytes });
+    }
+
+    /**
+     * Adds a patch of arm B.
+     *
+     * \param at Destination.
+     * \param bytes Bytes that will be written.
+     */
+    void add_b(const memory_pointer& at, const std::vector<uint8_t>& bytes) {
+        if (!m_running)
+            m_arms[1].push_back({ at.addressof(), bytes });
+    }
+
+    /**
+     * Saves the original code and switches to arm A.
+     *
+     * \return Was harness started (patches of A and B don't overlap).
+     */
+    bool start() {
+        if (m_running)
+            return false;
+
+        // A range patched by both arms has no original to measure against.
+        for (auto& a : m_arms[0]) {
+            for (auto& b : m_arms[1]) {
+                if ((a.address < b.address + b.bytes.size()) &&
+                    (b.address < a.address + a.bytes.size()))
+                    return false;
+            }
+        }
+
+        m_originals.clear();
+        for (auto& arm : m_arms) {
+            for (auto& now : arm) {
+                patch original{ now.address,
+                                std::vector<uint8_t>(now.bytes.size()) };
+                detail::read_memory_safe(now.address, original.bytes.data(),
+                                         original.bytes.size());
+                m_originals.push_back(std::move(original));
+            }
+        }
+
+        // Switching to an arm restores the other one first.
+        for (uint32_t i = 0; i < 2u; i++) {
+            auto& other = m_arms[i ^ 1u];
+            auto  first = (i == 0u) ? m_arms[0].size() : 0u;
+
+            m_switches[i].assign(m_originals.begin() + first,
+                                 m_originals.begin() + first + other.size());
+            m_switches[i].insert(m_switches[i].end(), m_arms[i].begin(),
+                                 m_arms[i].end());
+        }
+
+        toggle(0u);
+        m_ticks   = 0u;
+        m_last    = 0;
+        m_running = true;
+        return true;
+    }
+
+    /**
+     * Restores the original code.
+     */
+    void stop() {
+        if (!m_running)
+            return;
+
+        for (auto& now : m_originals)
+            m_transaction.add(now.address, now.bytes);
+
+        m_transaction.commit();
+        m_running = false;
+    }
+
+    /**
+     * Records a frame, switches arms every \c period \c ticks.
+     */
+    void tick() {
+        if (!m_running)
+            return;
+
+        LARGE_INTEGER counter;
+        QueryPerformanceCounter(&counter);
+
+        auto now  = counter.QuadPart;
+        auto last = m_last;
+        m_last    = now;
+
+        if (last && (m_ticks >= m_warmup)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_histograms[m_arm].add(static_cast<double>(now - last) /
+                                    m_frequency);
+        }
+
+        if (++m_ticks < m_period)
+            return;
+
+        toggle(m_arm ^ 1u);
+        m_ticks = 0u;
+    }
+
+    /**
+     * Builds the report.
+     *
+     * \param resamples Number of bootstrap resamples.
+     * \return Report of the run.
+     */
+    ab_report report(const uint32_t resamples = 200u) const {
+        frame_histogram a, b;
+        int64_t         toggle_max;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            a          = m_histograms[0];
+            b          = m_histograms[1];
+            toggle_max = m_toggle_max;
+        }
+
+        ab_report result{};
+        result.samples_a  = a.count();
+        result.samples_b  = b.count();
+        result.median_a   = a.quantile(0.5);
+        result.median_b   = b.quantile(0.5);
+        result.p99_a      = a.quantile(0.99);
+        result.p99_b      = b.quantile(0.99);
+        result.toggle_max = static_cast<double>(toggle_max) / m_frequency;
+
+        auto median = result.median_b - result.median_a;
+        auto p99    = result.p99_b - result.p99_a;
+
+        result.median = { median, median, median };
+        result.p99    = { p99, p99, p99 };
+
+        if (!a.count() || !b.count() || !resamples)
+            return result;
+
+        auto cumulative = [](const frame_histogram& histogram) {
+            std::vector<size_t> sums(frame_histogram::kBuckets);
+            size_t              total = 0u;
+
+            for (uint32_t i = 0; i < frame_histogram::kBuckets; i++)
+                sums[i] = (total += histogram.buckets()[i]);
+
+            return sums;
+        };
+
+        auto sums_a = cumulative(a);
+        auto sums_b = cumulative(b);
+
+        // Percentile bootstrap of both differences.
+        std::vector<double> medians, tails;
+        frame_histogram     sample_a, sample_b;
+        uint64_t            state = 0x9E3779B97F4A7C15ull;
+
+        for (uint32_t i = 0; i < resamples; i++) {
+            detail::resample_histogram(sums_a, state, sample_a);
+            detail::resample_histogram(sums_b, state, sample_b);
+
+            medians.push_back(sample_b.quantile(0.5) - sample_a.quantile(0.5));
+            tails.push_back(sample_b.quantile(0.99) - sample_a.quantile(0.99));
+        }
+
+        std::sort(medians.begin(), medians.end());
+        std::sort(tails.begin(), tails.end());
+
+        auto low  = static_cast<size_t>(0.025 * (resamples - 1u));
+        auto high = static_cast<size_t>(0.975 * (resamples - 1u));
+
+        result.median.low  = medians[low];
+        result.median.high = medians[high];
+        result.p99.low     = tails[low];
+        result.p99.high    = tails[high];
+        return result;
+    }
+
+    /**
+     * Drops recorded frames.
+     */
+    void reset() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_histograms[0].clear();
+        m_histograms[1].clear();
+        m_toggle_max = 0;
+    }
+
+    /**
+     * \return Active arm (0 - A, 1 - B).
+     */
+    uint32_t arm() const { return m_arm; }
+    /**
+     * \return Is harness running.
+     */
+    bool running() const { return m_running; }
+
+  private:
+    void toggle(const uint32_t arm) {
+        LARGE_INTEGER start, stop;
+        QueryPerformanceCounter(&start);
+
+        for (auto& now : m_switches[arm])
+            m_transaction.add(now.address, now.bytes);
+
+        m_transaction.commit();
+        m_arm = arm;
+
+        QueryPerformanceCounter(&stop);
+
+        auto cost = static_cast<int64_t>(stop.QuadPart - start.QuadPart);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_toggle_max = (std::max)(m_toggle_max, cost);
+    }
+};   // !class ab_harness
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_AB_HPP_
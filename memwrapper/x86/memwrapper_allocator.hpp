@@ -214,6 +214,21 @@ class asm_allocator : public basic_allocator {
         return *this;
     }
 };   // !class asm_allocator : public basic_allocator
+
+namespace detail {
+/**
+ * \param size Size of the code.
+ * \return Code page that is released with its last owner.
+ */
+inline std::shared_ptr<asm_allocator> make_code_page(
+    const uint32_t size = kPageSize4Kb) {
+    return std::shared_ptr<asm_allocator>(new asm_allocator(size),
+                                          [](asm_allocator* page) {
+                                              page->free();
+                                              delete page;
+                                          });
+}
+}   // namespace detail
 }   // namespace memwrapper
 
 #endif   // !MEMWRAPPER_ALLOCATOR_HPP_
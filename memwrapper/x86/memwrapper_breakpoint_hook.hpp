@@ -0,0 +1,346 @@
+﻿#ifndef MEMWRAPPER_BREAKPOINT_HOOK_HPP_
+#define MEMWRAPPER_BREAKPOINT_HOOK_HPP_
+
+namespace memwrapper {
+namespace detail {
+/**
+ * @brief Redirection of a breakpoint.
+ */
+struct breakpoint_route {
+    /**
+     * Address of the breakpoint.
+     */
+    uintptr_t address;
+    /**
+     * Address of the hooker.
+     */
+    uintptr_t hooker;
+};   // !struct breakpoint_route
+
+/**
+ * \param table Address-sorted routes.
+ * \param at Address of the breakpoint.
+ * \return First route not below the address.
+ */
+template<typename Table>
+inline auto lower_route(Table& table, const uintptr_t at)
+    -> decltype(table.begin()) {
+    return std::lower_bound(
+        table.begin(), table.end(), at,
+        [](const breakpoint_route& route, const uintptr_t address) {
+            return route.address < address;
+        });
+}
+
+/**
+ * @brief Address-sorted table of breakpoint hooks.
+ *
+ * The trap handler only loads the current table, writers copy it under a
+ * mutex and publish the copy. Replaced tables are kept while a handler may
+ * still read them: readers are counted, and every publish that sees no
+ * readers frees all replaced tables.
+ */
+class breakpoint_dispatch {
+    using table_t = std::vector<breakpoint_route>;
+
+  protected:
+    /**
+     * Current table.
+     */
+    std::atomic<const table_t*> m_table;
+    /**
+     * Current table and replaced ones that may still be read.
+     */
+    std::vector<std::unique_ptr<const table_t>> m_tables;
+    /**
+     * Number of lookups in progress.
+     */
+    std::atomic<uint32_t> m_readers;
+    /**
+     * Trampolines of destroyed hooks, never freed: a thread may still run
+     * the relocated instruction.
+     */
+    std::vector<std::unique_ptr<asm_allocator>> m_retired;
+    /**
+     * Guards writers.
+     */
+    std::mutex m_mutex;
+
+    breakpoint_dispatch()
+        : m_table(nullptr)
+        , m_readers(0u) {
+        publish({});
+        AddVectoredExceptionHandler(1, &handle);
+    }
+
+  public:
+    breakpoint_dispatch(const breakpoint_dispatch&) = delete;
+    breakpoint_dispatch(breakpoint_dispatch&&)      = delete;
+
+    /**
+     * \return Dispatch table of the process.
+     */
+    static breakpoint_dispatch& instance() {
+        static breakpoint_dispatch dispatch;
+        return dispatch;
+    }
+
+    /**
+     * Adds a route.
+     *
+     * \param at Address of the breakpoint.
+     * \param hooker Address of the hooker.
+     * \return Was route added (address wasn't routed).
+     */
+    bool add(const uintptr_t at, const uintptr_t hooker) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        table_t table(*m_table.load());
+        auto    it = lower_route(table, at);
+        if ((it != table.end()) && (it->address == at))
+            return false;
+
+        table.insert(it, { at, hooker });
+        publish(std::move(table));
+        return true;
+    }
+
+    /**
+     * Removes a route.
+     *
+     * \param at Address of the breakpoint.
+     */
+    void remove(const uintptr_t at) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        table_t table(*m_table.load());
+        auto    it = lower_route(table, at);
+        if ((it == table.end()) || (it->address != at))
+            return;
+
+        table.erase(it);
+        publish(std::move(table));
+    }
+
+    /**
+     * \param at Address of the breakpoint.
+     * \return Address of the hooker or zero.
+     */
+    uintptr_t find(const uintptr_t at) {
+        // Counted before the load, see publish().
+        m_readers.fetch_add(1u);
+
+        auto& table  = *m_table.load();
+        auto  it     = lower_route(table, at);
+        auto  hooker = ((it != table.end()) && (it->address == at))
+                           ? it->hooker
+                           : 0u;
+
+        m_readers.fetch_sub(1u, std::memory_order_release);
+        return hooker;
+    }
+
+    /**
+     * Keeps a trampoline of a destroyed hook until the process exits.
+     *
+     * \param code Trampoline.
+     */
+    void retire(std::unique_ptr<asm_allocator>&& code) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_retired.push_back(std::move(code));
+    }
+
+    /**
+     * \return Number of kept tables (with the current one).
+     */
+    size_t tables() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_tables.size();
+    }
+
+  private:
+    void publish(table_t&& table) {
+        m_tables.push_back(std::make_unique<const table_t>(std::move(table)));
+        m_table.store(m_tables.back().get());
+
+        // A reader that isn't counted yet will load the new table, so
+        // without readers every replaced table is unreachable.
+        if (m_readers.load() == 0u)
+            m_tables.erase(m_tables.begin(), m_tables.end() - 1);
+    }
+
+    static LONG NTAPI handle(EXCEPTION_POINTERS* info) {
+        if (info->ExceptionRecord->ExceptionCode != EXCEPTION_BREAKPOINT)
+            return EXCEPTION_CONTINUE_SEARCH;
+
+        auto at = reinterpret_cast<uintptr_t>(
+            info->ExceptionRecord->ExceptionAddress);
+
+        // Same stack and registers as a jump to the hooker.
+        if (auto hooker = instance().find(at)) {
+            info->ContextRecord->Eip = hooker;
+            return EXCEPTION_CONTINUE_EXECUTION;
+        }
+
+        return is_stale_breakpoint(info) ? EXCEPTION_CONTINUE_EXECUTION
+                                         : EXCEPTION_CONTINUE_SEARCH;
+    }
+};   // !class breakpoint_dispatch
+}   // namespace detail
+
+/**
+ * @brief Hook that patches a single \c int3 \c, for functions shorter
+ * than \c kJumpSize \c or with branch targets in the prologue.
+ *
+ * The trap handler redirects execution to the hooker, the original is
+ * called through a trampoline with the relocated first instruction. Every
+ * call of the hookee costs a trap (a round trip through the kernel).
+ *
+ * @code{.cpp}
+ * int __cdecl get_value_hooked();
+ * memwrapper::breakpoint_hook<decltype(&get_value_hooked)> hook{
+ *     0x00401000, &get_value_hooked };
+ *
+ * hook.install();
+ * // ...
+ * hook.call();
+ * @endcode
+ */
+template<typename Function>
+class breakpoint_hook {
+  protected:
+    using Ret = detail::return_type_t<Function>;
+
+    /**
+     * The function in memory where the hook will be installed.
+     */
+    memory_pointer m_hookee;
+    /**
+     * The function in memory that will be the hook.
+     */
+    memory_pointer m_hooker;
+    /**
+     * Relocated first instruction and a jump back.
+     */
+    std::unique_ptr<asm_allocator> m_trampoline_code;
+    /**
+     * Original first byte.
+     */
+    uint8_t m_original;
+    /**
+     * Is hook installed.
+     */
+    bool m_installed;
+
+  public:
+    breakpoint_hook(const breakpoint_hook&) = delete;
+    breakpoint_hook(breakpoint_hook&&)      = delete;
+
+    /**
+     * Constructor.
+     *
+     * \param hookee The function in memory where the hook will be installed.
+     * \param hooker The function in memory that will be the hook.
+     */
+    breakpoint_hook(const memory_pointer& hookee, const memory_pointer& hooker)
+        : m_hookee(hookee)
+        , m_hooker(hooker)
+        , m_original(0u)
+        , m_installed(false) {}
+
+    /**
+     * Destructor. The trampoline isn't freed, threads that trapped before
+     * the removal may still run it.
+     */
+    ~breakpoint_hook() {
+        remove();
+
+        if (m_trampoline_code)
+            detail::breakpoint_dispatch::instance().retire(
+                std::move(m_trampoline_code));
+    }
+
+    /**
+     * Installs the hook.
+     *
+     * \return Is hook installed.
+     */
+    bool install() {
+        if (m_installed)
+            return true;
+
+        if (!is_executable(m_hookee))
+            return false;
+
+        m_original = read_memory<uint8_t>(m_hookee);
+        if (m_original == kBreakpointOpcode)
+            return false;
+
+        if (!m_trampoline_code) {
+            auto trampoline = std::make_unique<asm_allocator>();
+
+            // One instruction, the jump back goes right after it.
+            uint8_t code[32];
+            size_t  taken = 0u;
+            auto    size  = detail::relocate_instructions(
+                m_hookee, 1u, code, trampoline->begin(), sizeof(code), taken);
+            if (!size) {
+                trampoline->free();
+                return false;
+            }
+
+            trampoline->db(code, static_cast<uint32_t>(size)).ready();
+            m_trampoline_code = std::move(trampoline);
+        }
+
+        if (!detail::breakpoint_dispatch::instance().add(
+                m_hookee.addressof(), m_hooker.addressof()))
+            return false;
+
+        write_memory(m_hookee, kBreakpointOpcode);
+        detail::ownership_registry::instance().add(m_hookee, sizeof(uint8_t));
+
+        m_installed = true;
+        return true;
+    }
+
+    /**
+     * Removes the hook.
+     */
+    void remove() {
+        if (!m_installed)
+            return;
+
+        // Restoring the byte first, traps in flight re-execute it.
+        write_memory(m_hookee, m_original);
+        detail::breakpoint_dispatch::instance().remove(m_hookee.addressof());
+        detail::ownership_registry::instance().remove(m_hookee,
+                                                      sizeof(uint8_t));
+
+        m_installed = false;
+    }
+
+    /**
+     * Calls the original function we hooked.
+     */
+    template<typename... Args>
+    Ret call(Args... args) const {
+        return call_function<Ret, detail::call_convention_v<Function>>(
+            original(), std::forward<Args>(args)...);
+    }
+
+    /**
+     * \return Address that executes the original function.
+     */
+    uintptr_t original() const {
+        return m_trampoline_code ? m_trampoline_code->get<uintptr_t>() : 0u;
+    }
+
+    /**
+     * \return Is hook installed.
+     */
+    bool installed() const { return m_installed; }
+};   // !class breakpoint_hook
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_BREAKPOINT_HOOK_HPP_
@@ -0,0 +1,229 @@
+﻿#ifndef MEMWRAPPER_BULK_HPP_
+#define MEMWRAPPER_BULK_HPP_
+
+namespace memwrapper {
+/**
+ * Pages behind a bulk buffer.
+ */
+enum class PageKind { None, Regular, Large };
+
+/**
+ * Allocation policy for bulk buffers.
+ */
+enum class BulkPagePolicy {
+    /**
+     * Always regular pages.
+     */
+    Regular,
+    /**
+     * Large pages when the buffer is big enough and SeLockMemoryPrivilege
+     * is already enabled (see \c enable_lock_memory_privilege() \c),
+     * regular pages otherwise.
+     */
+    PreferLarge
+};
+
+namespace detail {
+/**
+ * \return Current allocation policy for bulk buffers.
+ */
+inline std::atomic<BulkPagePolicy>& bulk_page_policy() {
+    static std::atomic<BulkPagePolicy> policy{ BulkPagePolicy::PreferLarge };
+    return policy;
+}
+
+/**
+ * Checks the process token without changing it.
+ *
+ * \return Is SeLockMemoryPrivilege enabled.
+ */
+inline bool query_lock_memory_privilege() {
+    HANDLE token = NULL;
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token))
+        return false;
+
+    PRIVILEGE_SET privileges{ 0 };
+    privileges.PrivilegeCount = 1;
+    privileges.Control        = PRIVILEGE_SET_ALL_NECESSARY;
+
+    BOOL enabled = FALSE;
+    bool result  = LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME,
+                                        &privileges.Privilege[0].Luid) &&
+                  PrivilegeCheck(token, &privileges, &enabled) && enabled;
+
+    CloseHandle(token);
+    return result;
+}
+
+/**
+ * \return Cached state of SeLockMemoryPrivilege, queried once and refreshed
+ * by \c enable_lock_memory_privilege() \c.
+ */
+inline std::atomic<bool>& lock_memory_privilege() {
+    static std::atomic<bool> enabled{ query_lock_memory_privilege() };
+    return enabled;
+}
+}   // namespace detail
+
+/**
+ * Enables SeLockMemoryPrivilege in the process token, it's required for
+ * large pages. Changes process-wide security state, so memwrapper never
+ * calls it by itself.
+ *
+ * \return Is privilege enabled.
+ */
+inline bool enable_lock_memory_privilege() {
+    HANDLE token = NULL;
+    if (!OpenProcessToken(GetCurrentProcess(),
+                          TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+        return false;
+
+    TOKEN_PRIVILEGES privileges{ 0 };
+    privileges.PrivilegeCount           = 1;
+    privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+    bool result =
+        LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME,
+                             &privileges.Privileges[0].Luid) &&
+        AdjustTokenPrivileges(token, FALSE, &privileges, 0, NULL, NULL) &&
+        (GetLastError() == ERROR_SUCCESS);   // Not ERROR_NOT_ALL_ASSIGNED.
+
+    CloseHandle(token);
+    detail::lock_memory_privilege().store(
+        detail::query_lock_memory_privilege());
+    return result;
+}
+
+/**
+ * Sets allocation policy for bulk buffers (snapshots, dumps, copied images).
+ *
+ * \param policy New policy.
+ */
+inline void set_bulk_page_policy(const BulkPagePolicy policy) {
+    detail::bulk_page_policy().store(policy);
+}
+
+/**
+ * @brief Large zero-initialized read-write buffer for memwrapper's internal
+ * bulk data. Backed by large pages when possible to reduce TLB misses
+ * during SIMD scans over it, falls back to regular pages.
+ */
+class bulk_buffer {
+  protected:
+    /**
+     * Start of the buffer.
+     */
+    uint8_t* m_data;
+    /**
+     * Size of the buffer (rounded up to the page size).
+     */
+    size_t m_size;
+    /**
+     * Pages behind the buffer.
+     */
+    PageKind m_kind;
+
+  public:
+    bulk_buffer(const bulk_buffer&) = delete;
+    bulk_buffer& operator=(const bulk_buffer&) = delete;
+
+    bulk_buffer()
+        : m_data(nullptr)
+        , m_size(0u)
+        , m_kind(PageKind::None) {}
+
+    /**
+     * Allocates the buffer.
+     *
+     * \param size Requested size.
+     */
+    bulk_buffer(const size_t size)
+        : bulk_buffer() {
+        if (!size)
+            return;
+
+        // Large pages only pay off for buffers that cover at least one.
+        auto large_page = GetLargePageMinimum();
+        if ((detail::bulk_page_policy().load() == BulkPagePolicy::PreferLarge) &&
+            large_page && (size >= large_page) &&
+            detail::lock_memory_privilege().load()) {
+            auto aligned = detail::align_value(size, large_page);
+
+            m_data = reinterpret_cast<uint8_t*>(
+                VirtualAlloc(NULL, aligned,
+                             MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES,
+                             PAGE_READWRITE));
+            if (m_data) {
+                m_size = aligned;
+                m_kind = PageKind::Large;
+                return;
+            }
+        }
+
+        auto aligned = detail::align_value(size, kPageSize4Kb);
+
+        m_data = reinterpret_cast<uint8_t*>(VirtualAlloc(
+            NULL, aligned, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+        if (m_data) {
+            m_size = aligned;
+            m_kind = PageKind::Regular;
+        }
+    }
+
+    bulk_buffer(bulk_buffer&& other)
+        : m_data(other.m_data)
+        , m_size(other.m_size)
+        , m_kind(other.m_kind) {
+        other.m_data = nullptr;
+        other.m_size = 0u;
+        other.m_kind = PageKind::None;
+    }
+
+    bulk_buffer& operator=(bulk_buffer&& other) {
+        if (this != &other) {
+            release();
+            std::swap(m_data, other.m_data);
+            std::swap(m_size, other.m_size);
+            std::swap(m_kind, other.m_kind);
+        }
+
+        return *this;
+    }
+
+    /**
+     * Destructor. Releases the buffer.
+     */
+    ~bulk_buffer() { release(); }
+
+    /**
+     * \return Start of the buffer.
+     */
+    uint8_t* data() const { return m_data; }
+    /**
+     * \return Size of the buffer.
+     */
+    size_t size() const { return m_size; }
+    /**
+     * \return Pages that were used for the buffer.
+     */
+    PageKind kind() const { return m_kind; }
+    /**
+     * \return Is buffer allocated.
+     */
+    bool good() const { return (m_data != nullptr); }
+
+    uint8_t& operator[](const size_t index) const { return m_data[index]; }
+
+  private:
+    void release() {
+        if (m_data)
+            VirtualFree(m_data, 0, MEM_RELEASE);
+
+        m_data = nullptr;
+        m_size = 0u;
+        m_kind = PageKind::None;
+    }
+};   // !class bulk_buffer
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_BULK_HPP_
@@ -0,0 +1,349 @@
+﻿#ifndef MEMWRAPPER_COVERAGE_HPP_
+#define MEMWRAPPER_COVERAGE_HPP_
+
+namespace memwrapper {
+namespace detail {
+/**
+ * A trap of an \c int3 \c that was removed while the trap was in flight
+ * must re-execute the restored instruction.
+ *
+ * \param info Exception of the breakpoint.
+ * \return Is breakpoint already removed.
+ */
+inline bool is_stale_breakpoint(const EXCEPTION_POINTERS* info) {
+    auto at = reinterpret_cast<uintptr_t>(
+        info->ExceptionRecord->ExceptionAddress);
+
+    return (info->ContextRecord->Eip == at) &&
+           (*reinterpret_cast<const uint8_t*>(at) != kBreakpointOpcode);
+}
+
+/**
+ * Finds basic block starts of a function with a linear sweep. The sweep
+ * stops at a return or an unconditional jump that no seen branch jumps over.
+ *
+ * \param start Start of the function.
+ * \param max_size Maximal size of the function.
+ * \return Sorted starts of basic blocks.
+ */
+inline std::vector<uintptr_t> find_basic_blocks(const memory_pointer& start,
+                                                const size_t max_size) {
+    std::vector<uintptr_t> instructions;
+    std::vector<uintptr_t> blocks{ start.addressof() };
+
+    auto begin    = start.addressof();
+    auto end      = begin + max_size;
+    auto now      = begin;
+    auto furthest = begin;
+
+    auto branch = [&](const uintptr_t target) {
+        if ((target >= begin) && (target < end)) {
+            blocks.push_back(target);
+            furthest = (std::max)(furthest, target);
+        }
+    };
+
+    while (now < end) {
+        hde32s hs;
+        auto   len = hde32_disasm(reinterpret_cast<const void*>(now), &hs);
+        if (hs.flags & F_ERROR)
+            break;
+
+        instructions.push_back(now);
+        auto next = now + len;
+        bool stop = false;
+
+        if (((hs.opcode & 0xF0) == 0x70) ||
+            ((hs.opcode == 0x0F) && ((hs.opcode2 & 0xF0) == 0x80))) {
+            auto short_jcc = ((hs.opcode & 0xF0) == 0x70);
+            branch(next + (short_jcc ? static_cast<int8_t>(hs.imm.imm8)
+                                     : hs.imm.imm32));
+            blocks.push_back(next);
+        } else if ((hs.opcode == 0xE9) || (hs.opcode == 0xEB)) {
+            auto short_jmp = (hs.opcode == 0xEB);
+            branch(next + (short_jmp ? static_cast<int8_t>(hs.imm.imm8)
+                                     : hs.imm.imm32));
+            stop = true;
+        } else if ((hs.opcode == 0xC3) || (hs.opcode == 0xC2) ||
+                   (hs.opcode == kBreakpointOpcode)) {
+            stop = true;
+        }
+
+        if (stop && (next > furthest))
+            break;
+
+        now = next;
+    }
+
+    // Only targets that are decoded instructions.
+    std::sort(blocks.begin(), blocks.end());
+    blocks.erase(std::unique(blocks.begin(), blocks.end()), blocks.end());
+    blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+                                [&](const uintptr_t at) {
+                                    return !std::binary_search(
+                                        instructions.begin(),
+                                        instructions.end(), at);
+                                }),
+                 blocks.end());
+
+    return blocks;
+}
+}   // namespace detail
+
+/**
+ * @brief One-shot breakpoint coverage.
+ *
+ * Every site gets an \c int3 \c. The first hit sets the bit of the site and
+ * restores its byte, so every site traps once and then runs at full speed.
+ * Sites are armed with one \c write_transaction \c (one protection change
+ * per region). Only one engine can be armed at a time. \c disarm() \c
+ * waits for trap handlers that may still be using the engine.
+ *
+ * @code{.cpp}
+ * memwrapper::coverage_engine coverage;
+ * coverage.add_blocks(0x00401000);
+ * coverage.arm();
+ * // ...
+ * coverage.disarm();
+ * auto executed = coverage.hits();
+ * @endcode
+ */
+class coverage_engine {
+  protected:
+    /**
+     * Sorted sites.
+     */
+    std::vector<uintptr_t> m_sites;
+    /**
+     * Original bytes of the sites.
+     */
+    std::vector<uint8_t> m_original;
+    /**
+     * Bit per site, set on hit.
+     */
+    std::unique_ptr<std::atomic<uint32_t>[]> m_bitmap;
+    /**
+     * Are sites armed.
+     */
+    bool m_armed;
+
+  public:
+    coverage_engine(const coverage_engine&) = delete;
+    coverage_engine(coverage_engine&&)      = delete;
+
+    coverage_engine()
+        : m_armed(false) {}
+
+    /**
+     * Destructor. Disarms the sites.
+     */
+    ~coverage_engine() { disarm(); }
+
+    /**
+     * Adds a site (function start or any instruction).
+     *
+     * \param at Address of the instruction.
+     */
+    void add_site(const memory_pointer& at) {
+        if (!m_armed)
+            m_sites.push_back(at.addressof());
+    }
+
+    /**
+     * Adds basic block starts of a function.
+     *
+     * \param function Start of the function.
+     * \param max_size Maximal size of the function.
+     * \return Number of added sites.
+     */
+    size_t add_blocks(const memory_pointer& function,
+                      const size_t          max_size = 0x1000u) {
+        if (m_armed)
+            return 0u;
+
+        auto blocks = detail::find_basic_blocks(function, max_size);
+        m_sites.insert(m_sites.end(), blocks.begin(), blocks.end());
+        return blocks.size();
+    }
+
+    /**
+     * Places breakpoints on all sites.
+     *
+     * \return Were sites armed.
+     */
+    bool arm() {
+        if (m_armed || m_sites.empty())
+            return false;
+
+        // The trap handler sees the engine only after its sites are final.
+        bool expected = false;
+        if (!reserved().compare_exchange_strong(expected, true))
+            return false;
+
+        std::sort(m_sites.begin(), m_sites.end());
+        m_sites.erase(std::unique(m_sites.begin(), m_sites.end()),
+                      m_sites.end());
+
+        // Existing breakpoints aren't ours.
+        m_original.resize(m_sites.size());
+        size_t kept = 0u;
+        for (size_t i = 0; i < m_sites.size(); i++) {
+            uint8_t byte = kBreakpointOpcode;
+            detail::read_memory_safe(m_sites[i], &byte, sizeof(byte));
+            if (byte == kBreakpointOpcode)
+                continue;
+
+            m_sites[kept]    = m_sites[i];
+            m_original[kept] = byte;
+            kept++;
+        }
+
+        m_sites.resize(kept);
+        m_original.resize(kept);
+
+        auto words = (kept + 31u) / 32u;
+        m_bitmap   = std::make_unique<std::atomic<uint32_t>[]>(words);
+        for (size_t i = 0; i < words; i++)
+            m_bitmap[i].store(0u, std::memory_order_relaxed);
+
+        install_handler();
+        active().store(this);
+
+        write_transaction transaction;
+        for (auto site : m_sites)
+            transaction.fill(site, kBreakpointOpcode, 1u);
+
+        transaction.commit();
+        m_armed = true;
+        return true;
+    }
+
+    /**
+     * Restores sites that weren't hit.
+     */
+    void disarm() {
+        if (!m_armed)
+            return;
+
+        write_transaction transaction;
+        for (size_t i = 0; i < m_sites.size(); i++) {
+            if (!hit(i))
+                transaction.add_value(m_sites[i], m_original[i]);
+        }
+
+        transaction.commit();
+        active().store(nullptr);
+
+        // Handlers that loaded the engine may still be using it.
+        while (handlers().load(std::memory_order_acquire) != 0u)
+            std::this_thread::yield();
+
+        m_armed = false;
+        reserved().store(false);
+    }
+
+    /**
+     * \param index Index of the site.
+     * \return Was site hit.
+     */
+    bool hit(const size_t index) const {
+        if (!m_bitmap || (index >= m_sites.size()))
+            return false;
+
+        auto word = m_bitmap[index / 32u].load(std::memory_order_relaxed);
+        return (word >> (index % 32u)) & 1u;
+    }
+
+    /**
+     * \return Sorted addresses of hit sites.
+     */
+    std::vector<uintptr_t> hits() const {
+        std::vector<uintptr_t> result;
+        for (size_t i = 0; i < m_sites.size(); i++) {
+            if (hit(i))
+                result.push_back(m_sites[i]);
+        }
+
+        return result;
+    }
+
+    /**
+     * \return Number of hit sites.
+     */
+    size_t hit_count() const {
+        size_t count = 0u;
+        for (size_t i = 0; i < m_sites.size(); i++)
+            count += hit(i);
+
+        return count;
+    }
+
+    /**
+     * \return Sorted sites (after arming).
+     */
+    const std::vector<uintptr_t>& sites() const { return m_sites; }
+    /**
+     * \return Are sites armed.
+     */
+    bool armed() const { return m_armed; }
+
+  private:
+    static std::atomic<coverage_engine*>& active() {
+        static std::atomic<coverage_engine*> engine{ nullptr };
+        return engine;
+    }
+
+    static std::atomic<bool>& reserved() {
+        static std::atomic<bool> flag{ false };
+        return flag;
+    }
+
+    static std::atomic<uint32_t>& handlers() {
+        static std::atomic<uint32_t> count{ 0u };
+        return count;
+    }
+
+    static void install_handler() {
+        // Never removed: a trap may still be in flight after disarming.
+        static PVOID handler = AddVectoredExceptionHandler(1, &handle);
+        (void)handler;
+    }
+
+    static LONG NTAPI handle(EXCEPTION_POINTERS* info) {
+        if (info->ExceptionRecord->ExceptionCode != EXCEPTION_BREAKPOINT)
+            return EXCEPTION_CONTINUE_SEARCH;
+
+        auto at = reinterpret_cast<uintptr_t>(
+            info->ExceptionRecord->ExceptionAddress);
+
+        // Counted before the load, see disarm().
+        handlers().fetch_add(1u);
+
+        auto engine = active().load();
+        auto ours   = engine && engine->on_breakpoint(at);
+
+        handlers().fetch_sub(1u, std::memory_order_release);
+        if (ours)
+            return EXCEPTION_CONTINUE_EXECUTION;
+
+        return detail::is_stale_breakpoint(info) ? EXCEPTION_CONTINUE_EXECUTION
+                                                 : EXCEPTION_CONTINUE_SEARCH;
+    }
+
+    bool on_breakpoint(const uintptr_t at) {
+        auto it = std::lower_bound(m_sites.begin(), m_sites.end(), at);
+        if ((it == m_sites.end()) || (*it != at))
+            return false;
+
+        auto index = static_cast<size_t>(it - m_sites.begin());
+        m_bitmap[index / 32u].fetch_or(1u << (index % 32u));
+
+        // One syscall, racing threads write the same byte.
+        WriteProcessMemory(GetCurrentProcess(), memory_pointer(at),
+                           &m_original[index], sizeof(uint8_t), NULL);
+        return true;
+    }
+};   // !class coverage_engine
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_COVERAGE_HPP_
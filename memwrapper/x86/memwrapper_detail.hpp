@@ -58,6 +58,30 @@ struct function_traits<Ret (Class::*)(Args...)> {
     static constexpr auto call_convention = CallingConvention::Thiscall;
 };   // !struct function_traits<Ret(Class::*)(Args...)>
 
+template<typename Ret, typename Class, typename... Args>
+struct function_traits<Ret (Class::*)(Args...) const> {
+    using return_type = Ret;
+
+    static constexpr auto args_count      = sizeof...(Args);
+    static constexpr auto call_convention = CallingConvention::Thiscall;
+};   // !struct function_traits<Ret(Class::*)(Args...) const>
+
+template<typename Ret, typename Class, typename... Args>
+struct function_traits<Ret (Class::*)(Args...) volatile> {
+    using return_type = Ret;
+
+    static constexpr auto args_count      = sizeof...(Args);
+    static constexpr auto call_convention = CallingConvention::Thiscall;
+};   // !struct function_traits<Ret(Class::*)(Args...) volatile>
+
+template<typename Ret, typename Class, typename... Args>
+struct function_traits<Ret (Class::*)(Args...) const volatile> {
+    using return_type = Ret;
+
+    static constexpr auto args_count      = sizeof...(Args);
+    static constexpr auto call_convention = CallingConvention::Thiscall;
+};   // !struct function_traits<Ret(Class::*)(Args...) const volatile>
+
 template<typename T>
 using return_type_t = typename function_traits<T>::return_type;
 
@@ -0,0 +1,519 @@
+﻿#ifndef MEMWRAPPER_DIFF_HPP_
+#define MEMWRAPPER_DIFF_HPP_
+
+namespace memwrapper {
+/**
+ * @brief Range of code that differs between memory and the file on disk.
+ */
+struct code_diff_range {
+    /**
+     * Address of the instruction that contains the first changed byte.
+     */
+    uintptr_t address;
+    /**
+     * Number of bytes in the range.
+     */
+    uint32_t size;
+    /**
+     * Instruction at \c address \c as it is in memory.
+     */
+    hde32s current;
+    /**
+     * Instruction at \c address \c as it is on disk (relocated).
+     */
+    hde32s original;
+    /**
+     * Destination of \c current \c if it is a relative jump or call
+     * (typical inline hook), zero otherwise.
+     */
+    uintptr_t destination;
+};   // !struct code_diff_range
+
+/**
+ * @brief Relocation-aware comparison of module code in memory with its file
+ * on disk.
+ *
+ * The file is mapped read-only, base relocations are applied on the fly to
+ * the blocks that contain them, all other blocks are compared directly with
+ * SSE2.
+ */
+class code_diff {
+  protected:
+    /**
+     * The module in memory.
+     */
+    image_view m_image;
+    /**
+     * The module file on disk.
+     */
+    module_file m_file;
+    /**
+     * Sorted relocations of the module.
+     */
+    std::vector<uint32_t> m_relocs;
+    /**
+     * Difference between actual and preferred base address.
+     */
+    uint32_t m_delta;
+
+  public:
+    code_diff(const code_diff&) = delete;
+    code_diff(code_diff&&)      = delete;
+
+    /**
+     * \param mod The module to compare. (example.dll, process.exe)
+     */
+    code_diff(std::string_view mod)
+        : code_diff(GetModuleHandle(mod.data())) {}
+
+    /**
+     * \param handle Base address of the module to compare.
+     */
+    code_diff(const HMODULE handle)
+        : m_image(handle)
+        , m_file(handle)
+        , m_delta(0u) {
+        if (!good())
+            return;
+
+        m_relocs = m_file.relocations();
+        m_delta  = m_image.base().addressof() - m_file.preferred_base();
+    }
+
+    /**
+     * Compares all executable sections.
+     *
+     * \param merge_gap Ranges separated by no more than this number of equal
+     * bytes are merged.
+     * \return Ranges that differ.
+     */
+    std::vector<code_diff_range> compare(const uint32_t merge_gap = 0u) const {
+        std::vector<code_diff_range> result;
+        if (!good())
+            return result;
+
+        auto section = m_image.sections();
+        for (uint32_t i = 0; i < m_image.sections_count(); i++, section++) {
+            if (!detail::is_executable_section(*section))
+                continue;
+
+            auto size = (std::min<uint32_t>)(detail::get_section_size(*section),
+                                   section->SizeOfRawData);
+
+            // Instructions are found by a sweep from the section start.
+            uint32_t boundary = section->VirtualAddress;
+            compare_range(section->VirtualAddress, size, merge_gap, boundary,
+                          result);
+        }
+
+        return result;
+    }
+
+    /**
+     * Builds the original bytes of the module with relocations applied.
+     *
+     * \param rva Relative virtual address of the first byte.
+     * \param out Buffer for the bytes.
+     * \param size Number of bytes.
+     * \return Was range backed by the file or not.
+     */
+    bool expected_bytes(const uint32_t rva, uint8_t* out,
+                        const uint32_t size) const {
+        auto file = m_file.rva_to_file(rva, size);
+        if (!file)
+            return false;
+
+        std::memcpy(out, file, size);
+        apply_relocations(rva, out, size);
+        return true;
+    }
+
+    /**
+     * Ranges the loader fills at run time: import address tables, delay-load
+     * slots and module handles, the TLS index, the security cookie and CFG
+     * function pointers. Some modules keep them inside executable sections,
+     * they differ from the file legitimately and must never be restored.
+     *
+     * \return Sorted ranges.
+     */
+    std::vector<owned_range> loader_ranges() const {
+        std::vector<owned_range> result;
+        if (!good())
+            return result;
+
+        auto base = m_image.base().addressof();
+        auto size = m_image.image_size();
+
+        auto add = [&](const uint32_t rva, const uint32_t length) {
+            if (!rva || !length || (rva >= size))
+                return;
+
+            result.push_back(
+                { base + rva, base + rva + (std::min)(length, size - rva) });
+        };
+
+        auto add_va = [&](const uintptr_t va, const uint32_t length) {
+            if (va > base)
+                add(static_cast<uint32_t>(va - base), length);
+        };
+
+        // Reads a structure of the image if it fits.
+        auto read = [&](const uint32_t rva, const uint32_t length)
+            -> const uint8_t* {
+            if (!rva || (rva >= size) || (length > size - rva))
+                return nullptr;
+
+            return m_image.base().front(rva).cast<const uint8_t*>();
+        };
+
+        auto iat = m_image.directory(IMAGE_DIRECTORY_ENTRY_IAT);
+        add(iat.VirtualAddress, iat.Size);
+
+        // Delay-load tables aren't covered by the IAT directory.
+        auto delay = m_image.directory(IMAGE_DIRECTORY_ENTRY_DELAY_IMPORT);
+        for (uint32_t at = delay.VirtualAddress;
+             at + sizeof(IMAGE_DELAYLOAD_DESCRIPTOR) <=
+             delay.VirtualAddress + delay.Size;
+             at += sizeof(IMAGE_DELAYLOAD_DESCRIPTOR)) {
+            using descriptor_t = IMAGE_DELAYLOAD_DESCRIPTOR;
+            auto descriptor    = reinterpret_cast<const descriptor_t*>(
+                read(at, sizeof(descriptor_t)));
+            if (!descriptor || !descriptor->DllNameRVA)
+                break;
+
+            // Old (VC6) descriptors hold addresses instead of RVAs.
+            auto to_rva = [&](const uint32_t value) -> uint32_t {
+                if (descriptor->Attributes.RvaBased)
+                    return value;
+
+                return (value > base) ? static_cast<uint32_t>(value - base)
+                                      : 0u;
+            };
+
+            add(to_rva(descriptor->ModuleHandleRVA), sizeof(HMODULE));
+
+            // The name table has as many entries as the address table.
+            uint32_t count = 0u;
+            auto     names = to_rva(descriptor->ImportNameTableRVA);
+            while (auto entry = read(names + count * sizeof(uint32_t),
+                                     sizeof(uint32_t))) {
+                if (!*reinterpret_cast<const uint32_t*>(entry))
+                    break;
+
+                count++;
+            }
+
+            add(to_rva(descriptor->ImportAddressTableRVA),
+                count * sizeof(uint32_t));
+        }
+
+        auto tls = m_image.directory(IMAGE_DIRECTORY_ENTRY_TLS);
+        if (auto directory = reinterpret_cast<const IMAGE_TLS_DIRECTORY32*>(
+                read(tls.VirtualAddress, sizeof(IMAGE_TLS_DIRECTORY32))))
+            add_va(directory->AddressOfIndex, sizeof(uint32_t));
+
+        // Fields of the load config exist only if its size covers them.
+        auto config = m_image.directory(IMAGE_DIRECTORY_ENTRY_LOAD_CONFIG);
+        if (auto directory =
+                reinterpret_cast<const IMAGE_LOAD_CONFIG_DIRECTORY32*>(
+                    read(config.VirtualAddress, sizeof(uint32_t)))) {
+            auto length = directory->Size;
+            if (!read(config.VirtualAddress, length))
+                length = 0u;
+
+            auto pointer = [&](const size_t offset, const uint32_t value) {
+                if (offset + sizeof(uint32_t) <= length)
+                    add_va(value, sizeof(uint32_t));
+            };
+
+            pointer(offsetof(IMAGE_LOAD_CONFIG_DIRECTORY32, SecurityCookie),
+                    directory->SecurityCookie);
+            pointer(offsetof(IMAGE_LOAD_CONFIG_DIRECTORY32,
+                             GuardCFCheckFunctionPointer),
+                    directory->GuardCFCheckFunctionPointer);
+            pointer(offsetof(IMAGE_LOAD_CONFIG_DIRECTORY32,
+                             GuardCFDispatchFunctionPointer),
+                    directory->GuardCFDispatchFunctionPointer);
+        }
+
+        std::sort(result.begin(), result.end(),
+                  [](const owned_range& a, const owned_range& b) {
+                      return a.begin < b.begin;
+                  });
+        return result;
+    }
+
+    /**
+     * \return The module in memory.
+     */
+    const image_view& image() const { return m_image; }
+
+    /**
+     * \return Is module and its file valid or not.
+     */
+    bool good() const { return m_image.good() && m_file.good(); }
+
+  private:
+    /**
+     * Applies relocations that overlap the buffer.
+     */
+    void apply_relocations(const uint32_t rva, uint8_t* out,
+                           const uint32_t size) const {
+        if (!m_delta)
+            return;
+
+        auto first = (rva >= sizeof(uint32_t)) ? rva - sizeof(uint32_t) + 1u : 0u;
+        auto it    = std::lower_bound(m_relocs.begin(), m_relocs.end(), first);
+
+        for (; (it != m_relocs.end()) && (*it < rva + size); ++it) {
+            auto file = m_file.rva_to_file(*it, sizeof(uint32_t));
+            if (!file)
+                continue;
+
+            detail::byteof<uint32_t> value{
+                *reinterpret_cast<const uint32_t*>(file) + m_delta
+            };
+
+            for (uint32_t k = 0; k < sizeof(uint32_t); k++) {
+                auto pos = *it + k;
+                if ((pos >= rva) && (pos < rva + size))
+                    out[pos - rva] = value.bytes[k];
+            }
+        }
+    }
+
+    /**
+     * Compares a committed and readable part of the section.
+     */
+    void compare_range(const uint32_t rva, const uint32_t size,
+                       const uint32_t merge_gap, uint32_t& boundary,
+                       std::vector<code_diff_range>& result) const {
+        auto now = rva;
+        auto end = rva + size;
+
+        while (now < end) {
+            MEMORY_BASIC_INFORMATION mbi{ 0 };
+            if (!VirtualQuery(m_image.base().front(now), &mbi, sizeof(mbi)))
+                break;
+
+            auto region_end = (std::min<uint32_t>)(
+                end, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(
+                                               mbi.BaseAddress) +
+                                           mbi.RegionSize -
+                                           m_image.base().addressof()));
+
+            // Skipping pages somebody made unreadable.
+            if ((mbi.State == MEM_COMMIT) && !(mbi.Protect & PAGE_GUARD) &&
+                !(mbi.Protect & PAGE_NOACCESS))
+                compare_block(now, region_end - now, merge_gap, boundary,
+                              result);
+
+            now = region_end;
+        }
+    }
+
+    /**
+     * Vectorized comparison of a readable block.
+     */
+    void compare_block(const uint32_t rva, const uint32_t size,
+                       const uint32_t merge_gap, uint32_t& boundary,
+                       std::vector<code_diff_range>& result) const {
+        constexpr uint32_t kBlock = sizeof(__m128i);
+
+        auto memory = m_image.base().front(rva).cast<const uint8_t*>();
+        auto file   = m_file.rva_to_file(rva, size);
+        if (!file)
+            return;
+
+        auto reloc = std::lower_bound(
+            m_relocs.begin(), m_relocs.end(),
+            (rva >= sizeof(uint32_t)) ? rva - sizeof(uint32_t) + 1u : 0u);
+
+        uint32_t range_begin = 0u;
+        uint32_t range_end   = 0u;
+        bool     opened      = false;
+
+        auto mark = [&](const uint32_t pos) {
+            if (opened && (pos <= range_end + merge_gap)) {
+                range_end = pos + 1u;
+                return;
+            }
+
+            if (opened)
+                push_range(range_begin, range_end, boundary, result);
+
+            range_begin = pos;
+            range_end   = pos + 1u;
+            opened      = true;
+        };
+
+        uint32_t offset = 0u;
+        while (offset < size) {
+            auto block_rva = rva + offset;
+            auto length    = (std::min<uint32_t>)(kBlock, size - offset);
+
+            // Skipping relocations that are behind the cursor.
+            while ((reloc != m_relocs.end()) &&
+                   (*reloc + sizeof(uint32_t) <= block_rva))
+                ++reloc;
+
+            bool relocated = m_delta && (reloc != m_relocs.end()) &&
+                             (*reloc < block_rva + length);
+
+            // Fast path: four blocks without relocations at once.
+            if (!relocated && (size - offset >= kBlock * 4u) &&
+                (!m_delta || (reloc == m_relocs.end()) ||
+                 (*reloc >= block_rva + kBlock * 4u))) {
+                auto m = reinterpret_cast<const __m128i*>(memory + offset);
+                auto f = reinterpret_cast<const __m128i*>(file + offset);
+
+                auto eq = _mm_and_si128(
+                    _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(m),
+                                                 _mm_loadu_si128(f)),
+                                  _mm_cmpeq_epi8(_mm_loadu_si128(m + 1),
+                                                 _mm_loadu_si128(f + 1))),
+                    _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128(m + 2),
+                                                 _mm_loadu_si128(f + 2)),
+                                  _mm_cmpeq_epi8(_mm_loadu_si128(m + 3),
+                                                 _mm_loadu_si128(f + 3))));
+
+                if (_mm_movemask_epi8(eq) == 0xFFFF) {
+                    offset += kBlock * 4u;
+                    continue;
+                }
+            }
+
+            alignas(16) uint8_t expected[kBlock]{ 0 };
+            alignas(16) uint8_t current[kBlock]{ 0 };
+            std::memcpy(expected, file + offset, length);
+            std::memcpy(current, memory + offset, length);
+
+            if (relocated)
+                apply_relocations(block_rva, expected, length);
+
+            auto diff = ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(
+                            _mm_load_si128(reinterpret_cast<__m128i*>(current)),
+                            _mm_load_si128(reinterpret_cast<__m128i*>(expected))))) &
+                        ((1u << length) - 1u);
+
+            for (uint32_t k = 0; diff; k++, diff >>= 1) {
+                if (diff & 1u)
+                    mark(block_rva + k);
+            }
+
+            offset += length;
+        }
+
+        if (opened)
+            push_range(range_begin, range_end, boundary, result);
+    }
+
+    /**
+     * Finds the instruction that contains a byte by a linear sweep of the
+     * file bytes, starting at a known instruction boundary that is moved to
+     * the found instruction.
+     */
+    uint32_t instruction_start(uint32_t& boundary, const uint32_t rva) const {
+        if (boundary > rva)
+            return rva;
+
+        auto file = m_file.rva_to_file(boundary, rva + 1u - boundary);
+        if (!file)
+            return rva;
+
+        uint8_t buf[16];
+        auto    now = boundary;
+        for (;;) {
+            // Near the byte the instruction may end outside the sweep.
+            auto code = m_file.rva_to_file(now, sizeof(buf));
+            if (!code) {
+                std::memset(buf, 0, sizeof(buf));
+                std::memcpy(buf, file + (now - boundary), rva + 1u - now);
+                code = buf;
+            }
+
+            // Garbage between functions is stepped over byte by byte.
+            auto len = (std::max)(hde32_length(code), 1u);
+            if (now + len > rva)
+                break;
+
+            now += len;
+        }
+
+        boundary = now;
+        return now;
+    }
+
+    /**
+     * Adds a range with decoded instructions.
+     */
+    void push_range(uint32_t begin, const uint32_t end, uint32_t& boundary,
+                    std::vector<code_diff_range>& result) const {
+        begin = instruction_start(boundary, begin);
+
+        // Changes inside one instruction may end up in two ranges.
+        auto address = m_image.base().front(begin).addressof();
+        if (!result.empty() &&
+            (result.back().address + result.back().size > address)) {
+            auto& last = result.back();
+            last.size  = (std::max)(last.size,
+                                    static_cast<uint32_t>(
+                                        m_image.base().front(end).addressof() -
+                                        last.address));
+            return;
+        }
+
+        code_diff_range range{};
+        range.address = address;
+        range.size    = end - begin;
+
+        // Decoding on a copy so we never read past the readable block.
+        uint8_t buf[32]{ 0 };
+        read_bytes(begin, buf, sizeof(buf));
+        hde32_disasm(buf, &range.current);
+
+        std::memset(buf, 0, sizeof(buf));
+        for (uint32_t len = sizeof(buf); len; len /= 2) {
+            if (expected_bytes(begin, buf, len))
+                break;
+        }
+        hde32_disasm(buf, &range.original);
+
+        if (!(range.current.flags & F_ERROR) &&
+            (range.current.flags & F_RELATIVE)) {
+            auto imm = (range.current.flags & F_IMM8)
+                           ? static_cast<uint32_t>(
+                                 static_cast<int8_t>(range.current.imm.imm8))
+                           : range.current.imm.imm32;
+
+            range.destination = detail::restore_absolute_address(
+                imm, range.address, range.current.len);
+        }
+
+        result.push_back(range);
+    }
+
+    /**
+     * Copies up to \c size \c readable bytes of the module.
+     */
+    void read_bytes(const uint32_t rva, uint8_t* out, const uint32_t size) const {
+        SIZE_T read = 0;
+        ReadProcessMemory(GetCurrentProcess(), m_image.base().front(rva), out,
+                          size, &read);
+        if (!read)
+            out[0] = *m_image.base().front(rva).cast<uint8_t*>();
+    }
+};   // !class code_diff
+
+/**
+ * Compares the executable sections of a module with its file on disk.
+ *
+ * \param mod The module to compare. (example.dll, process.exe)
+ * \return Ranges that differ (inline hooks, patches).
+ */
+inline std::vector<code_diff_range> diff_module_code(std::string_view mod) {
+    return code_diff(mod).compare();
+}
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_DIFF_HPP_
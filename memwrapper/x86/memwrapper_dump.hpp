@@ -0,0 +1,328 @@
+﻿#ifndef MEMWRAPPER_DUMP_HPP_
+#define MEMWRAPPER_DUMP_HPP_
+
+namespace memwrapper {
+/**
+ * \brief Size of the staging buffer used for dump writes.
+ */
+constexpr uint32_t kDumpBufferSize = 0x200000u;
+
+/**
+ * Receives every chunk of the dumped image in file order.
+ *
+ * \param rva Relative virtual address of the chunk.
+ * \param data Bytes of the chunk.
+ * \param size Size of the chunk.
+ */
+using dump_sink_t =
+    std::function<void(uint32_t rva, const uint8_t* data, uint32_t size)>;
+
+namespace detail {
+/**
+ * Reads memory of the current process without faulting on pages that are
+ * not committed or not readable. Such pages are zero-filled.
+ *
+ * \param from Memory to read.
+ * \param out Buffer for the bytes.
+ * \param size Number of bytes.
+ * \return Number of bytes that were actually read.
+ */
+inline size_t read_memory_safe(const memory_pointer& from, uint8_t* out,
+                               const size_t size) {
+    SIZE_T read = 0;
+    if (ReadProcessMemory(GetCurrentProcess(), from, out, size, &read) &&
+        (read == size))
+        return size;
+
+    // Falling back to page by page reading.
+    size_t    total = 0u;
+    uintptr_t now   = from.addressof();
+    uintptr_t end   = now + size;
+
+    while (now < end) {
+        auto page_end =
+            (std::min)(end, (now & ~(kPageSize4Kb - 1u)) + kPageSize4Kb);
+        auto length   = page_end - now;
+        auto dst      = out + (now - from.addressof());
+
+        read = 0;
+        if (ReadProcessMemory(GetCurrentProcess(), memory_pointer(now), dst,
+                              length, &read) &&
+            (read == length))
+            total += length;
+        else
+            std::memset(dst, 0, length);
+
+        now = page_end;
+    }
+
+    return total;
+}
+}   // namespace detail
+
+/**
+ * @brief Streams a loaded module into a PE file on disk.
+ *
+ * The image is rebuilt with file alignment equal to section alignment, so
+ * every section is stored at its virtual address. Memory is read in chunks
+ * through one staging buffer, the whole image is never held in memory.
+ */
+class module_dumper {
+  protected:
+    /**
+     * Handle of the output file.
+     */
+    HANDLE m_file;
+    /**
+     * Staging buffer.
+     */
+    bulk_buffer m_buffer;
+    /**
+     * Number of bytes in the staging buffer.
+     */
+    uint32_t m_buffered;
+    /**
+     * Relative virtual address of the first byte in the staging buffer.
+     */
+    uint32_t m_buffer_rva;
+    /**
+     * Number of pages that couldn't be read.
+     */
+    uint32_t m_unreadable_pages;
+    /**
+     * Optional consumer of the stream.
+     */
+    dump_sink_t m_sink;
+    /**
+     * Were all writes successful.
+     */
+    bool m_result;
+
+  public:
+    module_dumper(const module_dumper&) = delete;
+    module_dumper(module_dumper&&)      = delete;
+
+    /**
+     * \param path Path of the output file.
+     * \param sink Optional consumer that receives the same stream (for
+     * example a pattern scanner).
+     */
+    module_dumper(std::string_view path, dump_sink_t sink = nullptr)
+        : m_file(INVALID_HANDLE_VALUE)
+        , m_buffered(0u)
+        , m_buffer_rva(0u)
+        , m_unreadable_pages(0u)
+        , m_sink(std::move(sink))
+        , m_result(false) {
+        m_file = CreateFile(std::string(path).c_str(), GENERIC_WRITE, 0, NULL,
+                            CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+        if (m_file != INVALID_HANDLE_VALUE)
+            m_buffer = bulk_buffer(kDumpBufferSize);
+    }
+
+    /**
+     * Destructor. Closes the output file.
+     */
+    ~module_dumper() {
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+    }
+
+    /**
+     * Dumps a loaded module, replaces the output of a previous dump.
+     *
+     * \param handle Base address of the module.
+     * \return Was module dumped or not.
+     */
+    bool dump(const memory_pointer& handle) {
+        if (!good() || !handle)
+            return false;
+
+        // Starting the file over.
+        if ((SetFilePointer(m_file, 0, NULL, FILE_BEGIN) ==
+             INVALID_SET_FILE_POINTER) ||
+            !SetEndOfFile(m_file))
+            return false;
+
+        m_buffered         = 0u;
+        m_buffer_rva       = 0u;
+        m_unreadable_pages = 0u;
+
+        // Reading headers separately, they will be fixed.
+        IMAGE_DOS_HEADER dos{ 0 };
+        detail::read_memory_safe(handle, reinterpret_cast<uint8_t*>(&dos),
+                                 sizeof(dos));
+        if ((dos.e_magic != IMAGE_DOS_SIGNATURE) || (dos.e_lfanew <= 0))
+            return false;
+
+        IMAGE_NT_HEADERS nt{ 0 };
+        detail::read_memory_safe(handle.front(dos.e_lfanew),
+                                 reinterpret_cast<uint8_t*>(&nt), sizeof(nt));
+        if ((nt.Signature != IMAGE_NT_SIGNATURE) ||
+            !nt.OptionalHeader.SectionAlignment)
+            return false;
+
+        auto alignment    = nt.OptionalHeader.SectionAlignment;
+        auto headers_size = nt.OptionalHeader.SizeOfHeaders;
+
+        std::vector<uint8_t> headers(
+            detail::align_value(headers_size, alignment));
+        if (dos.e_lfanew + sizeof(IMAGE_NT_HEADERS) > headers.size())
+            return false;
+
+        detail::read_memory_safe(handle, headers.data(), headers_size);
+
+        auto pe = reinterpret_cast<IMAGE_NT_HEADERS*>(&headers[dos.e_lfanew]);
+        auto sections_offset =
+            reinterpret_cast<uint8_t*>(IMAGE_FIRST_SECTION(pe)) -
+            headers.data();
+        auto count = pe->FileHeader.NumberOfSections;
+
+        if (sections_offset + count * sizeof(IMAGE_SECTION_HEADER) >
+            headers.size())
+            return false;
+
+        // Fixing the layout: raw data is stored at virtual addresses.
+        pe->OptionalHeader.FileAlignment = alignment;
+        pe->OptionalHeader.SizeOfHeaders =
+            static_cast<uint32_t>(headers.size());
+        pe->OptionalHeader.ImageBase = handle.addressof();
+
+        auto sections = reinterpret_cast<IMAGE_SECTION_HEADER*>(
+            &headers[sections_offset]);
+        for (uint32_t i = 0; i < count; i++) {
+            sections[i].PointerToRawData = sections[i].VirtualAddress;
+            sections[i].SizeOfRawData    = detail::align_value(
+                detail::get_section_size(sections[i]), alignment);
+        }
+
+        m_result = true;
+        write(headers.data(), static_cast<uint32_t>(headers.size()));
+
+        // Streaming sections in file order.
+        std::vector<IMAGE_SECTION_HEADER> order(sections, sections + count);
+        std::sort(order.begin(), order.end(),
+                  [](const IMAGE_SECTION_HEADER& a,
+                     const IMAGE_SECTION_HEADER& b) {
+                      return a.VirtualAddress < b.VirtualAddress;
+                  });
+
+        for (auto& section : order) {
+            auto position = m_buffer_rva + m_buffered;
+            auto end      = section.VirtualAddress + section.SizeOfRawData;
+            if (end <= position)
+                continue;
+
+            // Overlapping sections are written from the current position.
+            if (section.VirtualAddress > position)
+                write_zeros(section.VirtualAddress - position);
+
+            position = m_buffer_rva + m_buffered;
+            stream(handle, position, end - position);
+        }
+
+        flush();
+        return m_result;
+    }
+
+    /**
+     * \return Number of pages that were zero-filled because they weren't
+     * readable.
+     */
+    uint32_t unreadable_pages() const { return m_unreadable_pages; }
+
+    /**
+     * \return Pages behind the staging buffer.
+     */
+    PageKind buffer_kind() const { return m_buffer.kind(); }
+
+    /**
+     * \return Is output file opened or not.
+     */
+    bool good() const {
+        return (m_file != INVALID_HANDLE_VALUE) && m_buffer.good();
+    }
+
+  private:
+    /**
+     * Reads memory straight into the staging buffer.
+     */
+    void stream(const memory_pointer& handle, uint32_t rva, uint32_t size) {
+        while (size) {
+            if (m_buffered == kDumpBufferSize)
+                flush();
+
+            auto length = (std::min)(size, kDumpBufferSize - m_buffered);
+            auto read   = detail::read_memory_safe(
+                handle.front(rva), &m_buffer[m_buffered], length);
+
+            m_unreadable_pages += (length - static_cast<uint32_t>(read)) /
+                                  kPageSize4Kb;
+            m_buffered += length;
+            rva += length;
+            size -= length;
+        }
+    }
+
+    void write(const uint8_t* data, uint32_t size) {
+        while (size) {
+            if (m_buffered == kDumpBufferSize)
+                flush();
+
+            auto length = (std::min)(size, kDumpBufferSize - m_buffered);
+            std::memcpy(&m_buffer[m_buffered], data, length);
+
+            m_buffered += length;
+            data += length;
+            size -= length;
+        }
+    }
+
+    void write_zeros(uint32_t size) {
+        while (size) {
+            if (m_buffered == kDumpBufferSize)
+                flush();
+
+            auto length = (std::min)(size, kDumpBufferSize - m_buffered);
+            std::memset(&m_buffer[m_buffered], 0, length);
+
+            m_buffered += length;
+            size -= length;
+        }
+    }
+
+    void flush() {
+        if (!m_buffered)
+            return;
+
+        if (m_sink)
+            m_sink(m_buffer_rva, m_buffer.data(), m_buffered);
+
+        DWORD written = 0;
+        if (!WriteFile(m_file, m_buffer.data(), m_buffered, &written, NULL) ||
+            (written != m_buffered))
+            m_result = false;
+
+        m_buffer_rva += m_buffered;
+        m_buffered = 0u;
+    }
+};   // !class module_dumper
+
+/**
+ * Dumps a loaded module into a PE file.
+ *
+ * \param mod The module to dump. (example.dll, process.exe)
+ * \param path Path of the output file.
+ * \return Was module dumped or not.
+ */
+inline bool dump_module(std::string_view mod, std::string_view path) {
+    memory_pointer handle = GetModuleHandle(mod.data());
+    if (!handle)
+        return false;
+
+    return module_dumper(path).dump(handle);
+}
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_DUMP_HPP_
@@ -0,0 +1,524 @@
+﻿#ifndef MEMWRAPPER_EMULATOR_HPP_
+#define MEMWRAPPER_EMULATOR_HPP_
+
+namespace memwrapper {
+/**
+ * \brief Initial esp of the emulator, reads above pushed values fail.
+ */
+constexpr uint32_t kEmulatorStack = 0xFFF00000u;
+
+/**
+ * @brief Request of \c resolve_computed_addresses \c.
+ */
+struct emulation_request {
+    /**
+     * First instruction.
+     */
+    uintptr_t start;
+    /**
+     * Instruction where emulation stops (zero - first unsupported one).
+     */
+    uintptr_t until;
+    /**
+     * Register that holds the result.
+     */
+    Registers result;
+    /**
+     * Maximal number of emulated instructions.
+     */
+    uint32_t max_steps;
+};   // !struct emulation_request
+
+namespace detail {
+/**
+ * @brief Emulated value, unknown if computed from unknown registers or
+ * unreadable memory.
+ */
+struct emulated_value {
+    uint32_t value;
+    bool     known;
+};   // !struct emulated_value
+
+/**
+ * Applies an ALU operation of the 80..83 group.
+ *
+ * \param operation Operation (reg field of modrm).
+ * \param a Destination.
+ * \param b Source.
+ * \param out Result.
+ * \return Is operation supported.
+ */
+inline bool apply_alu(const uint8_t operation, const uint32_t a,
+                      const uint32_t b, uint32_t& out) {
+    switch (operation) {
+        case 0: out = a + b; return true;
+        case 1: out = a | b; return true;
+        case 4: out = a & b; return true;
+        case 5: out = a - b; return true;
+        case 6: out = a ^ b; return true;
+        case 7: out = a; return true;   // cmp
+        default: return false;          // adc, sbb need flags
+    }
+}
+}   // namespace detail
+
+/**
+ * @brief Tiny x86 integer emulator over HDE for short pointer computing
+ * sequences: mov (including mov eax, [moffs32] and its store form), movzx,
+ * movsx, lea, add, or, and, sub, xor, cmp, inc,
+ * dec, not, neg, shifts, push, pop, jmp and call. Flags aren't modeled, so
+ * conditional jumps stop it.
+ *
+ * Registers start unknown and unknown values propagate, so the result
+ * tells whether it depends on the context of the real call. Memory is
+ * read with \c detail::read_memory_safe \c (one call per operand, code is
+ * read a page at a time), stores only go to an overlay.
+ *
+ * @code{.cpp}
+ * memwrapper::micro_emulator emulator{ 0x00401000 };
+ * emulator.run(16u, 0x00401020);
+ *
+ * uint32_t pointer;
+ * if (emulator.get(memwrapper::Registers::Eax, pointer))
+ *     // ...
+ * @endcode
+ */
+class micro_emulator {
+  protected:
+    /**
+     * Values of the registers.
+     */
+    uint32_t m_registers[8];
+    /**
+     * Bit per known register.
+     */
+    uint8_t m_known;
+    /**
+     * Next instruction.
+     */
+    uintptr_t m_eip;
+    /**
+     * Stored bytes.
+     */
+    std::unordered_map<uintptr_t, detail::emulated_value> m_stores;
+    /**
+     * Page of cached code.
+     */
+    uintptr_t m_code_page;
+    /**
+     * Number of instruction starts covered by the cache (zero - empty).
+     */
+    uintptr_t m_code_size;
+    /**
+     * Cached code page with the start of the next one, instructions may
+     * cross the page end.
+     */
+    uint8_t m_code[kPageSize4Kb + 16u];
+
+  public:
+    /**
+     * Constructor.
+     *
+     * \param start First instruction.
+     */
+    explicit micro_emulator(const memory_pointer& start)
+        : m_registers{}
+        , m_known(0u)
+        , m_eip(start.addressof())
+        , m_code_page(0u)
+        , m_code_size(0u) {
+        set(Registers::Esp, kEmulatorStack);
+    }
+
+    /**
+     * Sets a known value of a register.
+     *
+     * \param reg Register.
+     * \param value Value.
+     */
+    void set(const Registers reg, const uint32_t value) {
+        set_register(static_cast<uint8_t>(reg), { value, true });
+    }
+
+    /**
+     * \param reg Register.
+     * \param value Output value.
+     * \return Is value known.
+     */
+    bool get(const Registers reg, uint32_t& value) const {
+        auto index = static_cast<uint8_t>(reg);
+        value      = m_registers[index];
+        return (m_known >> index) & 1u;
+    }
+
+    /**
+     * Emulates one instruction.
+     *
+     * \return Is instruction supported.
+     */
+    bool step() {
+        if (m_eip - m_code_page >= m_code_size) {
+            m_code_page = m_eip & ~(kPageSize4Kb - 1u);
+            m_code_size = kPageSize4Kb;
+            detail::read_memory_safe(m_code_page, m_code, sizeof(m_code));
+        }
+
+        hde32s hs;
+        hde32_disasm(&m_code[m_eip - m_code_page], &hs);
+        if ((hs.flags & F_ERROR) || (hs.flags & F_PREFIX_ANY))
+            return false;
+
+        auto next = m_eip + hs.len;
+        auto reg  = hs.modrm_reg;
+
+        // 00..3F: ALU operations over r/m32 and r32.
+        if ((hs.opcode < 0x40) && ((hs.opcode & 0x07) <= 0x03) &&
+            (hs.opcode & 0x01)) {
+            auto operation = static_cast<uint8_t>(hs.opcode >> 3);
+            auto to_reg    = (hs.opcode & 0x02) != 0;
+            auto rm        = read_rm(hs, 4u);
+            auto other     = get_register(reg);
+
+            auto a = to_reg ? other : rm;
+            auto b = to_reg ? rm : other;
+
+            detail::emulated_value result{ 0u, a.known && b.known };
+            if (!detail::apply_alu(operation, a.value, b.value, result.value))
+                return false;
+
+            // xor eax, eax and sub eax, eax don't depend on eax.
+            if ((hs.modrm_mod == 3) && (hs.modrm_rm == reg) &&
+                ((operation == 5) || (operation == 6)))
+                result = { 0u, true };
+
+            if ((operation != 7) &&
+                !(to_reg ? set_register(reg, result) : write_rm(hs, result)))
+                return false;
+        } else if ((hs.opcode < 0x40) && ((hs.opcode & 0x07) == 0x05)) {
+            // ALU operation over eax and imm32.
+            auto operation = static_cast<uint8_t>(hs.opcode >> 3);
+            auto eax       = get_register(0u);
+
+            detail::emulated_value result{ 0u, eax.known };
+            if (!detail::apply_alu(operation, eax.value, hs.imm.imm32,
+                                   result.value))
+                return false;
+
+            if (operation != 7)
+                set_register(0u, result);
+        } else if ((hs.opcode == 0x81) || (hs.opcode == 0x83)) {
+            auto rm  = read_rm(hs, 4u);
+            auto imm = (hs.opcode == 0x83)
+                           ? static_cast<uint32_t>(
+                                 static_cast<int8_t>(hs.imm.imm8))
+                           : hs.imm.imm32;
+
+            detail::emulated_value result{ 0u, rm.known };
+            if (!detail::apply_alu(reg, rm.value, imm, result.value))
+                return false;
+
+            if ((reg != 7) && !write_rm(hs, result))
+                return false;
+        } else if ((hs.opcode >= 0x40) && (hs.opcode <= 0x4F)) {
+            // inc r32, dec r32
+            auto now = get_register(hs.opcode & 0x07);
+            now.value += (hs.opcode < 0x48) ? 1u : static_cast<uint32_t>(-1);
+            set_register(hs.opcode & 0x07, now);
+        } else if ((hs.opcode >= 0x50) && (hs.opcode <= 0x57)) {
+            if (!push(get_register(hs.opcode & 0x07)))
+                return false;
+        } else if ((hs.opcode >= 0x58) && (hs.opcode <= 0x5F)) {
+            detail::emulated_value value;
+            if (!pop(value))
+                return false;
+
+            set_register(hs.opcode & 0x07, value);
+        } else if ((hs.opcode == 0x68) || (hs.opcode == 0x6A)) {
+            auto imm = (hs.opcode == 0x6A)
+                           ? static_cast<uint32_t>(
+                                 static_cast<int8_t>(hs.imm.imm8))
+                           : hs.imm.imm32;
+
+            if (!push({ imm, true }))
+                return false;
+        } else if (hs.opcode == 0x89) {
+            if (!write_rm(hs, get_register(reg)))
+                return false;
+        } else if (hs.opcode == 0x8B) {
+            set_register(reg, read_rm(hs, 4u));
+        } else if (hs.opcode == 0x8D) {
+            if (hs.modrm_mod == 3)
+                return false;
+
+            detail::emulated_value value{ 0u, false };
+            value.known = effective_address(hs, value.value);
+            set_register(reg, value);
+        } else if ((hs.opcode == 0xA1) || (hs.opcode == 0xA3)) {
+            // mov eax, [moffs32] and mov [moffs32], eax
+            if (hs.opcode == 0xA1)
+                set_register(0u, read(hs.imm.imm32, 4u));
+            else if (!write(hs.imm.imm32, get_register(0u)))
+                return false;
+        } else if (hs.opcode == 0x90) {
+            // nop
+        } else if ((hs.opcode >= 0xB8) && (hs.opcode <= 0xBF)) {
+            set_register(hs.opcode & 0x07, { hs.imm.imm32, true });
+        } else if ((hs.opcode == 0xC1) || (hs.opcode == 0xD1)) {
+            auto rm    = read_rm(hs, 4u);
+            auto count = (hs.opcode == 0xD1) ? 1u : (hs.imm.imm8 & 0x1Fu);
+
+            switch (reg) {
+                case 4: rm.value <<= count; break;
+                case 5: rm.value >>= count; break;
+                case 7:
+                    rm.value = static_cast<uint32_t>(
+                        static_cast<int32_t>(rm.value) >> count);
+                    break;
+                default: return false;
+            }
+
+            if (!write_rm(hs, rm))
+                return false;
+        } else if ((hs.opcode == 0xC7) && (reg == 0)) {
+            if (!write_rm(hs, { hs.imm.imm32, true }))
+                return false;
+        } else if (hs.opcode == 0xE8) {
+            if (!push({ static_cast<uint32_t>(next), true }))
+                return false;
+
+            next += hs.imm.imm32;
+        } else if ((hs.opcode == 0xE9) || (hs.opcode == 0xEB)) {
+            next += (hs.opcode == 0xEB) ? static_cast<int8_t>(hs.imm.imm8)
+                                        : hs.imm.imm32;
+        } else if ((hs.opcode == 0xF7) && ((reg == 2) || (reg == 3))) {
+            auto rm  = read_rm(hs, 4u);
+            rm.value = (reg == 2) ? ~rm.value : (0u - rm.value);
+
+            if (!write_rm(hs, rm))
+                return false;
+        } else if ((hs.opcode == 0x0F) &&
+                   ((hs.opcode2 & 0xF6) == 0xB6)) {
+            // movzx, movsx
+            auto size  = (hs.opcode2 & 0x01) ? 2u : 1u;
+            auto value = read_rm(hs, size);
+
+            if (hs.opcode2 & 0x08)
+                value.value = (size == 1u)
+                                  ? static_cast<uint32_t>(
+                                        static_cast<int8_t>(value.value))
+                                  : static_cast<uint32_t>(
+                                        static_cast<int16_t>(value.value));
+
+            set_register(reg, value);
+        } else {
+            return false;
+        }
+
+        m_eip = next;
+        return true;
+    }
+
+    /**
+     * Emulates instructions.
+     *
+     * \param max_steps Maximal number of instructions.
+     * \param until Instruction where emulation stops (optional).
+     * \return Number of emulated instructions.
+     */
+    size_t run(const size_t max_steps, const memory_pointer& until = nullptr) {
+        size_t steps = 0u;
+        while ((steps < max_steps) && (m_eip != until.addressof()) && step())
+            steps++;
+
+        return steps;
+    }
+
+    /**
+     * \return Next instruction.
+     */
+    uintptr_t eip() const { return m_eip; }
+
+  private:
+    detail::emulated_value get_register(const uint8_t index) const {
+        return { m_registers[index], ((m_known >> index) & 1u) != 0 };
+    }
+
+    bool set_register(const uint8_t                index,
+                      const detail::emulated_value value) {
+        auto bit = static_cast<uint8_t>(1u << index);
+
+        m_registers[index] = value.value;
+        m_known = value.known ? (m_known | bit) : (m_known & ~bit);
+        return true;
+    }
+
+    bool effective_address(const hde32s& hs, uint32_t& out) const {
+        out = 0u;
+
+        auto add = [&](const uint8_t index, const uint32_t scale) {
+            auto value = get_register(index);
+            out += value.value * scale;
+            return value.known;
+        };
+
+        bool known = true;
+        if (hs.flags & F_SIB) {
+            if (!((hs.sib_base == 5) && (hs.modrm_mod == 0)))
+                known &= add(hs.sib_base, 1u);
+
+            if (hs.sib_index != 4)
+                known &= add(hs.sib_index, 1u << hs.sib_scale);
+        } else if (!((hs.modrm_rm == 5) && (hs.modrm_mod == 0))) {
+            known &= add(hs.modrm_rm, 1u);
+        }
+
+        if (hs.flags & F_DISP8)
+            out += static_cast<uint32_t>(static_cast<int8_t>(hs.disp.disp8));
+        else if (hs.flags & F_DISP32)
+            out += hs.disp.disp32;
+
+        return known;
+    }
+
+    detail::emulated_value read(const uint32_t at, const uint32_t size) const {
+        detail::emulated_value result{ 0u, true };
+
+        // Memory is read once for the whole operand.
+        uint8_t bytes[sizeof(uint32_t)]{ 0 };
+        bool    readable = true;
+        bool    loaded   = false;
+
+        for (uint32_t i = 0; i < size; i++) {
+            uint8_t byte = 0u;
+            auto    it   = m_stores.find(at + i);
+
+            if (it != m_stores.end()) {
+                byte = static_cast<uint8_t>(it->second.value);
+                result.known &= it->second.known;
+            } else {
+                if (!loaded) {
+                    readable = (detail::read_memory_safe(at, bytes, size) ==
+                                size);
+                    loaded   = true;
+                }
+
+                byte = bytes[i];
+                result.known &= readable;
+            }
+
+            result.value |= static_cast<uint32_t>(byte) << (8u * i);
+        }
+
+        return result;
+    }
+
+    detail::emulated_value read_rm(const hde32s&  hs,
+                                   const uint32_t size) const {
+        if (hs.modrm_mod != 3) {
+            uint32_t at = 0u;
+            if (!effective_address(hs, at))
+                return { 0u, false };
+
+            return read(at, size);
+        }
+
+        // al..bl, ah..bh
+        auto index = (size == 1u) ? (hs.modrm_rm & 3) : hs.modrm_rm;
+        auto value = get_register(static_cast<uint8_t>(index));
+        if ((size == 1u) && (hs.modrm_rm >= 4))
+            value.value >>= 8;
+
+        if (size < 4u)
+            value.value &= (1u << (8u * size)) - 1u;
+        return value;
+    }
+
+    bool write(const uint32_t at, const detail::emulated_value value) {
+        for (uint32_t i = 0; i < sizeof(uint32_t); i++)
+            m_stores[at + i] = { (value.value >> (8u * i)) & 0xFFu,
+                                 value.known };
+
+        return true;
+    }
+
+    bool write_rm(const hde32s& hs, const detail::emulated_value value) {
+        if (hs.modrm_mod == 3)
+            return set_register(hs.modrm_rm, value);
+
+        // A store to an unknown address may overwrite anything.
+        uint32_t at = 0u;
+        return effective_address(hs, at) && write(at, value);
+    }
+
+    bool push(const detail::emulated_value value) {
+        auto esp = get_register(static_cast<uint8_t>(Registers::Esp));
+        if (!esp.known)
+            return false;
+
+        esp.value -= sizeof(uint32_t);
+        set_register(static_cast<uint8_t>(Registers::Esp), esp);
+        return write(esp.value, value);
+    }
+
+    bool pop(detail::emulated_value& value) {
+        auto esp = get_register(static_cast<uint8_t>(Registers::Esp));
+        if (!esp.known)
+            return false;
+
+        value = read(esp.value, sizeof(uint32_t));
+        esp.value += sizeof(uint32_t);
+        set_register(static_cast<uint8_t>(Registers::Esp), esp);
+        return true;
+    }
+};   // !class micro_emulator
+
+/**
+ * Emulates a snippet that computes an address.
+ *
+ * \param start First instruction.
+ * \param until Instruction where emulation stops (zero - first unsupported
+ * one).
+ * \param result Register that holds the result.
+ * \param max_steps Maximal number of emulated instructions.
+ * \return Computed address or zero if it's unknown.
+ */
+inline uintptr_t resolve_computed_address(const memory_pointer& start,
+                                          const memory_pointer& until,
+                                          const Registers       result,
+                                          const uint32_t max_steps = 32u) {
+    micro_emulator emulator(start);
+    emulator.run(max_steps, until);
+
+    uint32_t value = 0u;
+    if (!emulator.get(result, value))
+        return 0u;
+
+    // Stopped before reaching the end.
+    if (until && (emulator.eip() != until.addressof()))
+        return 0u;
+
+    return value;
+}
+
+/**
+ * Emulates a batch of snippets in parallel.
+ *
+ * \param requests Snippets.
+ * \return Computed addresses (zero if unknown) in the order of requests.
+ */
+inline std::vector<uintptr_t>
+resolve_computed_addresses(const std::vector<emulation_request>& requests) {
+    std::vector<uintptr_t> result(requests.size(), 0u);
+
+    detail::worker_pool::instance().parallel_for(
+        requests.size(), [&](const size_t index) {
+            auto& now     = requests[index];
+            result[index] = resolve_computed_address(
+                now.start, now.until, now.result, now.max_steps);
+        });
+
+    return result;
+}
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_EMULATOR_HPP_
@@ -0,0 +1,368 @@
+﻿#ifndef MEMWRAPPER_FREEZER_HPP_
+#define MEMWRAPPER_FREEZER_HPP_
+
+namespace memwrapper {
+/**
+ * @brief Statistics of a freezer tick.
+ */
+struct freeze_stats {
+    /**
+     * Number of frozen values.
+     */
+    size_t values;
+    /**
+     * Rewritten values.
+     */
+    size_t drifted;
+    /**
+     * Pages with rewritten values.
+     */
+    size_t pages;
+    /**
+     * Pages skipped because they aren't readable any more (freed objects).
+     */
+    size_t skipped;
+    /**
+     * Protection changes made.
+     */
+    size_t batches;
+    /**
+     * Duration of the tick in milliseconds.
+     */
+    double milliseconds;
+};   // !struct freeze_stats
+
+namespace detail {
+/**
+ * Compares two buffers 16 bytes at a time.
+ *
+ * \param a First buffer.
+ * \param b Second buffer.
+ * \param size Size of both buffers.
+ * \return Are buffers equal.
+ */
+inline bool equal_bytes(const uint8_t* a, const uint8_t* b, const size_t size) {
+    size_t i = 0u;
+    for (; i + 16u <= size; i += 16u) {
+        auto eq = _mm_cmpeq_epi8(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        if (_mm_movemask_epi8(eq) != 0xFFFF)
+            return false;
+    }
+
+    return !std::memcmp(a + i, b + i, size - i);
+}
+}   // namespace detail
+
+/**
+ * @brief Keeps values pinned, for example a fixed game state while
+ * benchmarking.
+ *
+ * Frozen values are packed by address. Every \c tick() \c gathers the
+ * current bytes of the values, compares them page by page with SSE2 and
+ * rewrites only drifted values with one \c write_transaction \c, so a page
+ * costs at most one protection change and pages without drift cost none.
+ * Every page is gathered with one \c detail::read_memory_safe \c, pages
+ * that were freed meanwhile are skipped and counted.
+ *
+ * @code{.cpp}
+ * memwrapper::value_freezer freezer;
+ * freezer.freeze_value<float>(0x00B6F5F0, 100.0f);
+ * freezer.freeze(0x00B6F600, "\x01\x02", 2);
+ *
+ * // once per frame or from a timer
+ * auto stats = freezer.tick();
+ * @endcode
+ */
+class value_freezer {
+    struct value {
+        uintptr_t            address;
+        std::vector<uint8_t> bytes;
+    };
+
+    struct entry {
+        uintptr_t address;
+        uint32_t  offset;
+        uint32_t  size;
+    };
+
+    struct page {
+        uint32_t first;
+        uint32_t last;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+  protected:
+    /**
+     * Frozen values.
+     */
+    std::vector<value> m_values;
+    /**
+     * Values sorted by address.
+     */
+    std::vector<entry> m_entries;
+    /**
+     * Ranges of entries and packed bytes per page.
+     */
+    std::vector<page> m_pages;
+    /**
+     * Frozen bytes, packed in the order of entries.
+     */
+    std::vector<uint8_t> m_frozen;
+    /**
+     * Current bytes, packed in the order of entries.
+     */
+    std::vector<uint8_t> m_current;
+    /**
+     * Bytes of the page being gathered.
+     */
+    std::vector<uint8_t> m_gather;
+    /**
+     * Rewrites of a tick, keeps its buffers between ticks.
+     */
+    write_transaction m_transaction;
+    /**
+     * Statistics of the last tick.
+     */
+    freeze_stats m_last;
+    /**
+     * Sum of drifted values of all ticks.
+     */
+    uint64_t m_total_drifted;
+    /**
+     * Number of ticks.
+     */
+    uint64_t m_ticks;
+    /**
+     * QPC frequency in ticks per millisecond.
+     */
+    double m_frequency;
+    /**
+     * Are packed values outdated.
+     */
+    bool m_dirty;
+    /**
+     * Guards values.
+     */
+    mutable std::mutex m_mutex;
+
+  public:
+    value_freezer(const value_freezer&) = delete;
+    value_freezer(value_freezer&&)      = delete;
+
+    value_freezer()
+        : m_last{}
+        , m_total_drifted(0u)
+        , m_ticks(0u)
+        , m_dirty(false) {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        m_frequency = static_cast<double>(frequency.QuadPart) / 1000.0;
+    }
+
+    /**
+     * Freezes bytes, replaces a value frozen at the same address.
+     *
+     * \param at Address of the value.
+     * \param data Frozen bytes.
+     * \param size Size of the value.
+     */
+    void freeze(const memory_pointer& at, const memory_pointer& data,
+                const size_t size) {
+        if (!size)
+            return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto bytes = data.cast<const uint8_t*>();
+        auto it    = find(at.addressof());
+        if (it != m_values.end())
+            it->bytes.assign(bytes, bytes + size);
+        else
+            m_values.push_back(
+                { at.addressof(), std::vector<uint8_t>(bytes, bytes + size) });
+
+        m_dirty = true;
+    }
+
+    /**
+     * Freezes a value.
+     *
+     * \param at Address of the value.
+     * \param value Frozen value.
+     */
+    template<typename T>
+    void freeze_value(const memory_pointer& at, const T value) {
+        freeze(at, &value, sizeof(T));
+    }
+
+    /**
+     * Unfreezes a value.
+     *
+     * \param at Address of the value.
+     * \return Was value frozen.
+     */
+    bool unfreeze(const memory_pointer& at) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = find(at.addressof());
+        if (it == m_values.end())
+            return false;
+
+        m_values.erase(it);
+        m_dirty = true;
+        return true;
+    }
+
+    /**
+     * Unfreezes all values.
+     */
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_values.clear();
+        m_dirty = true;
+    }
+
+    /**
+     * Rewrites drifted values.
+     *
+     * \return Statistics of the tick.
+     */
+    freeze_stats tick() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        LARGE_INTEGER start, stop;
+        QueryPerformanceCounter(&start);
+
+        if (m_dirty)
+            rebuild();
+
+        freeze_stats stats{};
+        stats.values = m_entries.size();
+
+        for (auto& now : m_pages) {
+            auto begin = m_entries[now.first].address;
+            auto end   = begin;
+            for (auto i = now.first; i < now.last; i++)
+                end = (std::max)(end, m_entries[i].address + m_entries[i].size);
+
+            // Frozen objects may be freed, the page is read without faulting.
+            m_gather.resize(end - begin);
+            if (detail::read_memory_safe(begin, m_gather.data(),
+                                         m_gather.size()) != m_gather.size()) {
+                stats.skipped++;
+                continue;
+            }
+
+            for (auto i = now.first; i < now.last; i++) {
+                auto& value = m_entries[i];
+                std::memcpy(&m_current[value.offset],
+                            &m_gather[value.address - begin], value.size);
+            }
+
+            if (detail::equal_bytes(&m_current[now.begin], &m_frozen[now.begin],
+                                    now.end - now.begin))
+                continue;
+
+            for (auto i = now.first; i < now.last; i++) {
+                auto& value = m_entries[i];
+                if (!std::memcmp(&m_current[value.offset],
+                                 &m_frozen[value.offset], value.size))
+                    continue;
+
+                m_transaction.add(value.address, &m_frozen[value.offset],
+                                  value.size);
+                stats.drifted++;
+            }
+
+            stats.pages++;
+        }
+
+        stats.batches = m_transaction.commit();
+
+        QueryPerformanceCounter(&stop);
+        stats.milliseconds =
+            static_cast<double>(stop.QuadPart - start.QuadPart) / m_frequency;
+
+        m_last = stats;
+        m_total_drifted += stats.drifted;
+        m_ticks++;
+        return stats;
+    }
+
+    /**
+     * \return Statistics of the last tick.
+     */
+    freeze_stats last() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_last;
+    }
+
+    /**
+     * \return Sum of drifted values of all ticks.
+     */
+    uint64_t total_drifted() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_total_drifted;
+    }
+
+    /**
+     * \return Number of ticks.
+     */
+    uint64_t ticks() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_ticks;
+    }
+
+    /**
+     * \return Number of frozen values.
+     */
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_values.size();
+    }
+
+  private:
+    std::vector<value>::iterator find(const uintptr_t at) {
+        return std::find_if(
+            m_values.begin(), m_values.end(),
+            [at](const value& now) { return now.address == at; });
+    }
+
+    void rebuild() {
+        std::sort(m_values.begin(), m_values.end(),
+                  [](const value& a, const value& b) {
+                      return a.address < b.address;
+                  });
+
+        m_entries.clear();
+        m_pages.clear();
+        m_frozen.clear();
+
+        for (auto& now : m_values) {
+            auto offset = static_cast<uint32_t>(m_frozen.size());
+            auto size   = static_cast<uint32_t>(now.bytes.size());
+            auto index  = static_cast<uint32_t>(m_entries.size());
+            auto at     = now.address & ~(kPageSize4Kb - 1u);
+
+            // A value belongs to the page of its first byte.
+            if (m_pages.empty() ||
+                ((m_entries.back().address & ~(kPageSize4Kb - 1u)) != at))
+                m_pages.push_back({ index, index, offset, offset });
+
+            m_entries.push_back({ now.address, offset, size });
+            m_frozen.insert(m_frozen.end(), now.bytes.begin(), now.bytes.end());
+
+            m_pages.back().last = index + 1u;
+            m_pages.back().end  = offset + size;
+        }
+
+        m_current.resize(m_frozen.size());
+        m_dirty = false;
+    }
+};   // !class value_freezer
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_FREEZER_HPP_
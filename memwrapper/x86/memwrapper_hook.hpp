@@ -14,22 +14,40 @@ enum MemhookFlags : uint32_t {
 
 struct memhook_context {
     uintptr_t return_address;
+    /**
+     * Calls through the hook, approximate (not locked).
+     */
+    uint32_t calls;
 };   // struct memhook_context;
+
+/**
+ * Offset of the jump to the hooker in a trampoline.
+ */
+constexpr uint32_t kTrampolineJump = 0x18u;
+/**
+ * Offset of the relocated original code in a trampoline.
+ */
+constexpr uint32_t kTrampolineOriginal = 0x20u;
 }   // namespace detail
 
 /**
  * Constants.
  */
-constexpr uint8_t  kCallOpcode = 0xE8;
-constexpr uint8_t  kJumpOpcode = 0xE9;
-constexpr uint8_t  kNopOpcode  = 0x90;
-constexpr uint32_t kJumpSize   = 0x05u;
+constexpr uint8_t  kCallOpcode       = 0xE8;
+constexpr uint8_t  kJumpOpcode       = 0xE9;
+constexpr uint8_t  kNopOpcode        = 0x90;
+constexpr uint8_t  kBreakpointOpcode = 0xCC;
+constexpr uint32_t kJumpSize         = 0x05u;
+/**
+ * Upper bound of the size of a trampoline.
+ */
+constexpr uint32_t kMaxTrampolineSize = 0x80u;
 
 template<typename Function>
 class memhook {
   protected:
     using memhook_original_code_t = std::unique_ptr<uint8_t[]>;
-    using memhook_trampoline_t    = std::unique_ptr<asm_allocator>;
+    using memhook_trampoline_t    = std::shared_ptr<asm_allocator>;
 
     using memhook_flags_t    = detail::MemhookFlags;
     using memhook_call_abs_t = uintptr_t;
@@ -53,9 +71,13 @@ class memhook {
      */
     memhook_original_code_t m_original_code;
     /**
-     * ASM code for the trampoline.
+     * Page with the trampoline, may be shared by hot trampolines.
      */
     memhook_trampoline_t m_trampoline_code;
+    /**
+     * Offset of the trampoline in its page.
+     */
+    uint32_t m_trampoline_offset;
     /**
      * Hook flags.
      */
@@ -88,21 +110,22 @@ class memhook {
         : m_hookee(hookee)
         , m_hooker(hooker)
         , m_size(0u)
+        , m_trampoline_offset(0u)
         , m_call_abs(0u)
-        , m_flags(memhook_flags_t::kNone) {
+        , m_flags(memhook_flags_t::kNone)
+        , m_context{} {
         uint8_t* cursor = m_hookee;
 
         while (m_size < kJumpSize) {
-            hde32s hs;
-            hde32_disasm(cursor, &hs);
+            auto len = hde32_length(cursor);
 
-            if (hs.flags & F_ERROR) {
+            if (!len) {
                 m_flags |= memhook_flags_t::kListingBroken;
                 break;
             }
 
-            m_size += hs.len;
-            cursor += hs.len;
+            m_size += len;
+            cursor += len;
         }
 
         if (is_executable(m_hookee))
@@ -118,7 +141,8 @@ class memhook {
      * Installs the hook.
      */
     void install() {
-        using std::make_unique, detail::get_relative_address;
+        using std::make_unique, detail::get_relative_address,
+            detail::make_code_page;
 
         // Checking is we available to place hook.
         if ((m_flags & memhook_flags_t::kInstalled) ||
@@ -128,8 +152,7 @@ class memhook {
 
         if (m_original_code) {
             // Installing jump to our hooker-function again.
-            m_trampoline_code->set_offset(0xBu);
-            m_trampoline_code->jmp(m_hooker).ready();
+            write_trampoline_jump(m_hooker);
 
             // Marking as installed.
             m_flags |= memhook_flags_t::kInstalled;
@@ -147,26 +170,15 @@ class memhook {
         }
 
         // Creating trampoline and original code instances.
-        m_original_code   = make_unique<uint8_t[]>(m_size);
-        m_trampoline_code = make_unique<asm_allocator>();
+        m_original_code     = make_unique<uint8_t[]>(m_size);
+        m_trampoline_code   = make_code_page();
+        m_trampoline_offset = 0u;
 
         // Copying original code.
-        copy_memory(m_original_code.get(), m_hookee, m_size);
-
-        // Copying return address into `m_context` structure.
-        m_trampoline_code->push(Registers::Eax)
-            .mov(Registers::Eax, Registers::Esp, sizeof(uint32_t))
-            .mov(&m_context.return_address, Registers::Eax)
-            .pop(Registers::Eax)
-            // Jumping to our hooker-function.
-            .jmp(m_hooker);
+        detail::backup_memory(m_original_code.get(), m_hookee, m_size);
 
-        // Rewriting original instructions.
-        if ((m_flags & memhook_flags_t::kCallInstruction) == 0)
-            generate_trampoline_instructions();
-
-        // Marking as ready to execute.
-        m_trampoline_code->ready();
+        // Generating the trampoline.
+        generate_trampoline();
 
         // Patching `hookee`.
         if ((m_flags & memhook_flags_t::kCallInstruction) == 0)
@@ -174,12 +186,15 @@ class memhook {
 
         write_memory(
             m_hookee.front(1u),
-            get_relative_address(m_trampoline_code->begin(), m_hookee));
+            get_relative_address(trampoline(), m_hookee));
 
         if (m_size > kJumpSize)
             fill_memory(m_hookee.front(kJumpSize), kNopOpcode,
                         m_size - kJumpSize);
 
+        // Registering the patched prologue.
+        detail::ownership_registry::instance().add(m_hookee, m_size);
+
         // Marking as installed.
         m_flags |= memhook_flags_t::kInstalled;
     }
@@ -196,10 +211,9 @@ class memhook {
         auto unload_hook = [this]() {
             // Copying original instructions back.
             copy_memory(m_hookee, m_original_code.get(), m_size);
+            detail::ownership_registry::instance().remove(m_hookee, m_size);
 
-            // Releasing the trampoline.
-            m_trampoline_code->free();
-
+            // Releasing the trampoline with the last owner of its page.
             // Resetting the smart pointers.
             m_trampoline_code.reset();
             m_original_code.reset();
@@ -211,17 +225,13 @@ class memhook {
         auto patch_hook = [this]() {
             if (m_flags & memhook_flags_t::kCallInstruction) {
                 // Redirecting jump to stored function absolute address;
-                m_trampoline_code->set_offset(0xBu);
-                m_trampoline_code->jmp(m_call_abs);
+                write_trampoline_jump(m_call_abs);
             } else {
                 // Nop jump to avoid crash or calling hooker-function.
-                fill_memory(m_trampoline_code->get(0xBu), kNopOpcode,
-                            kJumpSize);
+                detail::fill_trampoline(trampoline() + detail::kTrampolineJump,
+                                        kNopOpcode, kJumpSize);
             }
 
-            // Flushing trampoline.
-            m_trampoline_code->ready();
-
             // Marking as uninstalled.
             m_flags &= ~memhook_flags_t::kInstalled;
         };
@@ -237,9 +247,7 @@ class memhook {
 
         uintptr_t destination =
             detail::restore_absolute_address(hs.imm.imm32, m_hookee, hs.len);
-        uintptr_t trampoline = m_trampoline_code->get<uintptr_t>();
-
-        if ((destination == trampoline) || (destination == m_call_abs))
+        if ((destination == trampoline()) || (destination == m_call_abs))
             unload_hook();
         else
             patch_hook();
@@ -257,7 +265,7 @@ class memhook {
         if ((m_flags & memhook_flags_t::kCallInstruction))
             call_address = m_call_abs;
         else
-            call_address = m_trampoline_code->get(0x10u);
+            call_address = trampoline() + detail::kTrampolineOriginal;
 
         // Calling our function.
         return call_function<Ret, call_convention_v<Function>>(
@@ -266,7 +274,106 @@ class memhook {
 
     detail::memhook_context get_context() const { return m_context; }
 
+    /**
+     * \return Approximate number of calls through the hook.
+     */
+    uint32_t calls() const { return m_context.calls; }
+    /**
+     * Resets the number of calls.
+     */
+    void reset_calls() { m_context.calls = 0u; }
+    /**
+     * \return Is hook installed.
+     */
+    bool installed() const {
+        return (m_flags & memhook_flags_t::kInstalled) != 0;
+    }
+    /**
+     * \return Patched instruction (jump or call) of the hookee.
+     */
+    uintptr_t hookee() const { return m_hookee.addressof(); }
+    /**
+     * \return Address of the trampoline, zero if it isn't created.
+     */
+    uintptr_t trampoline() const {
+        if (!m_trampoline_code)
+            return 0u;
+
+        return m_trampoline_code->begin().addressof() + m_trampoline_offset;
+    }
+
+    /**
+     * Regenerates the trampoline at the current position of another page.
+     * The hookee still goes to the old trampoline until its operand is
+     * retargeted to \c trampoline() \c.
+     *
+     * \param page Page with at least \c kMaxTrampolineSize \c free bytes.
+     * \return Page of the old trampoline (must live while threads may run
+     * in it) or nullptr if hook isn't installed.
+     */
+    memhook_trampoline_t relocate_trampoline(const memhook_trampoline_t& page) {
+        if (!installed() || !page)
+            return nullptr;
+
+        auto old            = std::move(m_trampoline_code);
+        m_trampoline_code   = page;
+        m_trampoline_offset = page->get_offset();
+
+        generate_trampoline();
+        return old;
+    }
+
+    /**
+     * Undoes \c relocate_trampoline() \c while the hookee still goes to the
+     * old trampoline.
+     *
+     * \param page Page of the old trampoline.
+     * \param at Address of the old trampoline.
+     */
+    void restore_trampoline(const memhook_trampoline_t& page,
+                            const uintptr_t             at) {
+        m_trampoline_code   = page;
+        m_trampoline_offset = at - page->begin().addressof();
+    }
+
   private:
+    void generate_trampoline() {
+        auto& code = *m_trampoline_code;
+
+        // Copying return address into `m_context` structure.
+        code.push(Registers::Eax)
+            .mov(Registers::Eax, Registers::Esp, sizeof(uint32_t))
+            .mov(&m_context.return_address, Registers::Eax);
+
+        // Counting calls with eax, flags may be alive.
+        code.db(0xA1).dbvalue(&m_context.calls);   // mov eax, [calls]
+        code.db(0x8D).db(0x40).db(0x01);           // lea eax, [eax + 1]
+        code.mov(&m_context.calls, Registers::Eax)
+            .pop(Registers::Eax)
+            // Jumping to our hooker-function.
+            .jmp(m_hooker);
+
+        // A removed jump falls through to the original code.
+        while (code.get_offset() <
+               m_trampoline_offset + detail::kTrampolineOriginal)
+            code.db(kNopOpcode);
+
+        // Rewriting original instructions.
+        if ((m_flags & memhook_flags_t::kCallInstruction) == 0)
+            generate_trampoline_instructions();
+
+        // Marking as ready to execute.
+        code.ready();
+    }
+
+    void write_trampoline_jump(const memory_pointer& to) {
+        auto                 at  = trampoline() + detail::kTrampolineJump;
+        detail::jmp_relative jmp = { kJumpOpcode,
+                                     detail::get_relative_address(to, at) };
+
+        detail::write_trampoline(at, &jmp, sizeof(jmp));
+    }
+
     void generate_trampoline_instructions() {
         using detail::get_relative_address, detail::restore_absolute_address;
 
@@ -275,11 +382,13 @@ class memhook {
         detail::jmp_relative  jmp  = { 0xE9, 0x00000000u };
         detail::jcc_relative  jcc  = { 0x0F, 0x80, 0x00000000u };
 
-        uint8_t* now  = m_hookee;
+        // Decoding the backup, the hookee may be patched already.
         uint32_t step = 0u;
 
         bool finished = false;
         while (!finished) {
+            uint8_t* now = m_hookee.front(step);
+
             if (step >= m_size) {
                 m_trampoline_code->jmp(now);
                 break;
@@ -289,7 +398,8 @@ class memhook {
             uint32_t oplen;
 
             hde32s   hs;
-            uint32_t len = hde32_disasm(now, &hs);
+            uint8_t* source = m_original_code.get() + step;
+            uint32_t len    = hde32_disasm(source, &hs);
 
             if (hs.flags & F_ERROR)
                 break;
@@ -335,7 +445,7 @@ class memhook {
                 opcode = &jcc;
                 oplen  = sizeof(jcc);
             } else {
-                opcode = now;
+                opcode = source;
                 oplen  = len;
             }
 
@@ -343,8 +453,7 @@ class memhook {
             m_trampoline_code->db(opcode, oplen);
 
             // Shifting cursor.
-            step += oplen;
-            now += len;
+            step += len;
         }
     }
 };
@@ -0,0 +1,306 @@
+﻿#ifndef MEMWRAPPER_IMAGE_HPP_
+#define MEMWRAPPER_IMAGE_HPP_
+
+namespace memwrapper {
+namespace detail {
+/**
+ * Returns the NT headers of a PE image.
+ *
+ * \param base Start of the image (module handle or mapped file).
+ * \return Pointer to the NT headers or nullptr if image isn't valid.
+ */
+inline IMAGE_NT_HEADERS* get_nt_headers(const memory_pointer& base) {
+    if (!base)
+        return nullptr;
+
+    auto dos = base.cast<IMAGE_DOS_HEADER*>();
+    if (dos->e_magic != IMAGE_DOS_SIGNATURE)
+        return nullptr;
+
+    auto pe = base.front(dos->e_lfanew).cast<IMAGE_NT_HEADERS*>();
+    if (pe->Signature != IMAGE_NT_SIGNATURE)
+        return nullptr;
+
+    return pe;
+}
+
+/**
+ * \return Size of the section in memory.
+ */
+inline uint32_t get_section_size(const IMAGE_SECTION_HEADER& section) {
+    return (section.Misc.VirtualSize != 0) ? section.Misc.VirtualSize
+                                           : section.SizeOfRawData;
+}
+
+/**
+ * \return Is section contains executable code.
+ */
+inline bool is_executable_section(const IMAGE_SECTION_HEADER& section) {
+    return (section.Characteristics & IMAGE_SCN_MEM_EXECUTE) ||
+           (section.Characteristics & IMAGE_SCN_CNT_CODE);
+}
+}   // namespace detail
+
+/**
+ * @brief Read-only view of a PE image. Works for modules loaded in memory
+ * and for files mapped with \c module_file \c.
+ */
+class image_view {
+  protected:
+    /**
+     * Start of the image.
+     */
+    memory_pointer m_base;
+    /**
+     * NT headers of the image.
+     */
+    IMAGE_NT_HEADERS* m_nt;
+
+  public:
+    image_view()
+        : m_base(nullptr)
+        , m_nt(nullptr) {}
+
+    /**
+     * \param base Start of the image.
+     */
+    image_view(const memory_pointer& base)
+        : m_base(base)
+        , m_nt(detail::get_nt_headers(base)) {}
+
+    /**
+     * \return Start of the image.
+     */
+    memory_pointer base() const { return m_base; }
+    /**
+     * \return NT headers of the image.
+     */
+    IMAGE_NT_HEADERS* nt() const { return m_nt; }
+
+    /**
+     * \return Pointer to the first section header.
+     */
+    IMAGE_SECTION_HEADER* sections() const {
+        return good() ? IMAGE_FIRST_SECTION(m_nt) : nullptr;
+    }
+
+    /**
+     * \return Number of sections.
+     */
+    uint32_t sections_count() const {
+        return good() ? m_nt->FileHeader.NumberOfSections : 0u;
+    }
+
+    /**
+     * \return Size of the image in memory.
+     */
+    uint32_t image_size() const {
+        return good() ? m_nt->OptionalHeader.SizeOfImage : 0u;
+    }
+
+    /**
+     * \return Preferred base address of the image.
+     */
+    uint32_t preferred_base() const {
+        return good() ? m_nt->OptionalHeader.ImageBase : 0u;
+    }
+
+    /**
+     * \param index Index of the data directory.
+     * \return Data directory entry.
+     */
+    IMAGE_DATA_DIRECTORY directory(const uint32_t index) const {
+        if (!good() || (index >= m_nt->OptionalHeader.NumberOfRvaAndSizes))
+            return { 0u, 0u };
+
+        return m_nt->OptionalHeader.DataDirectory[index];
+    }
+
+    /**
+     * \return Is image valid or not.
+     */
+    bool good() const { return (m_nt != nullptr); }
+};   // !class image_view
+
+/**
+ * @brief RAII read-only mapping of a module file from the disk.
+ */
+class module_file : public image_view {
+  protected:
+    /**
+     * Handle of the file.
+     */
+    HANDLE m_file;
+    /**
+     * Handle of the file mapping.
+     */
+    HANDLE m_mapping;
+    /**
+     * Size of the file.
+     */
+    uint32_t m_size;
+
+  public:
+    module_file(const module_file&) = delete;
+    module_file(module_file&&)      = delete;
+
+    /**
+     * Maps the file of a loaded module.
+     *
+     * \param handle Base address of the loaded module.
+     */
+    module_file(const HMODULE handle)
+        : m_file(INVALID_HANDLE_VALUE)
+        , m_mapping(NULL)
+        , m_size(0u) {
+        char path[MAX_PATH]{ 0 };
+        if (!handle ||
+            !GetModuleFileName(handle, path, MAX_PATH))
+            return;
+
+        open(path);
+    }
+
+    /**
+     * Maps a file from the disk.
+     *
+     * \param path Path to the file.
+     */
+    module_file(std::string_view path)
+        : m_file(INVALID_HANDLE_VALUE)
+        , m_mapping(NULL)
+        , m_size(0u) {
+        open(std::string(path).c_str());
+    }
+
+    /**
+     * Destructor. Unmaps the file.
+     */
+    ~module_file() {
+        if (m_base)
+            UnmapViewOfFile(m_base);
+
+        if (m_mapping)
+            CloseHandle(m_mapping);
+
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+    }
+
+    /**
+     * \return Size of the file.
+     */
+    uint32_t file_size() const { return m_size; }
+
+    /**
+     * Converts a relative virtual address to the pointer into the file.
+     *
+     * \param rva Relative virtual address.
+     * \param size Number of bytes that must be available.
+     * \return Pointer into the file or nullptr if rva isn't backed by file.
+     */
+    const uint8_t* rva_to_file(const uint32_t rva, const uint32_t size = 1u) const {
+        if (!good())
+            return nullptr;
+
+        uint32_t offset = rva;
+        if (rva >= m_nt->OptionalHeader.SizeOfHeaders) {
+            auto section = find_section(rva);
+            if (!section || ((rva - section->VirtualAddress) + size >
+                             section->SizeOfRawData))
+                return nullptr;
+
+            offset = section->PointerToRawData + (rva - section->VirtualAddress);
+        }
+
+        if (offset + size > m_size)
+            return nullptr;
+
+        return m_base.front(offset).cast<const uint8_t*>();
+    }
+
+    /**
+     * Finds the section that contains a relative virtual address.
+     *
+     * \param rva Relative virtual address.
+     * \return Section header or nullptr.
+     */
+    const IMAGE_SECTION_HEADER* find_section(const uint32_t rva) const {
+        auto section = sections();
+        for (uint32_t i = 0; i < sections_count(); i++, section++) {
+            auto size = detail::get_section_size(*section);
+            if ((rva >= section->VirtualAddress) &&
+                (rva < section->VirtualAddress + size))
+                return section;
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * Collects the relative virtual addresses of all HIGHLOW base
+     * relocations.
+     *
+     * \return Sorted vector of relocated addresses.
+     */
+    std::vector<uint32_t> relocations() const {
+        std::vector<uint32_t> result;
+
+        auto dir = directory(IMAGE_DIRECTORY_ENTRY_BASERELOC);
+        if (!dir.VirtualAddress || !dir.Size)
+            return result;
+
+        auto now = rva_to_file(dir.VirtualAddress, dir.Size);
+        if (!now)
+            return result;
+
+        auto end = now + dir.Size;
+        while (now + sizeof(IMAGE_BASE_RELOCATION) <= end) {
+            auto block = reinterpret_cast<const IMAGE_BASE_RELOCATION*>(now);
+            if ((block->SizeOfBlock < sizeof(IMAGE_BASE_RELOCATION)) ||
+                (now + block->SizeOfBlock > end))
+                break;
+
+            auto entries = reinterpret_cast<const uint16_t*>(block + 1);
+            auto count   = (block->SizeOfBlock - sizeof(IMAGE_BASE_RELOCATION)) /
+                         sizeof(uint16_t);
+
+            for (size_t i = 0; i < count; i++) {
+                // Only 32-bit relocations exist in x86 images.
+                if ((entries[i] >> 12) == IMAGE_REL_BASED_HIGHLOW)
+                    result.push_back(block->VirtualAddress + (entries[i] & 0xFFF));
+            }
+
+            now += block->SizeOfBlock;
+        }
+
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+
+  private:
+    void open(const char* path) {
+        m_file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_file == INVALID_HANDLE_VALUE)
+            return;
+
+        m_size    = GetFileSize(m_file, NULL);
+        m_mapping = CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!m_mapping)
+            return;
+
+        m_base = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!m_base || (m_size < sizeof(IMAGE_DOS_HEADER)))
+            return;
+
+        // Headers must be inside the file.
+        auto lfanew = m_base.cast<IMAGE_DOS_HEADER*>()->e_lfanew;
+        if ((lfanew > 0) &&
+            (static_cast<uint32_t>(lfanew) + sizeof(IMAGE_NT_HEADERS) <= m_size))
+            m_nt = detail::get_nt_headers(m_base);
+    }
+};   // !class module_file
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_IMAGE_HPP_
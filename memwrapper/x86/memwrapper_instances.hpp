@@ -0,0 +1,224 @@
+﻿#ifndef MEMWRAPPER_INSTANCES_HPP_
+#define MEMWRAPPER_INSTANCES_HPP_
+
+namespace memwrapper {
+/**
+ * \brief Validates a candidate object, called from worker threads.
+ */
+using instance_predicate_t = std::function<bool(uintptr_t)>;
+
+namespace detail {
+/**
+ * \brief Vtables compared one by one with SSE2, larger sets are range
+ * checked and searched.
+ */
+constexpr size_t kMaxSimdVtables = 8u;
+
+/**
+ * \brief Memory is copied and scanned in blocks of this size, on the stack
+ * of the sweeping thread.
+ */
+constexpr uint32_t kInstanceBlockSize = 4u * kPageSize4Kb;
+
+/**
+ * Finds every aligned dword that equals one of sorted values.
+ *
+ * \param begin Start of the block (4 byte aligned).
+ * \param end End of the block.
+ * \param values Sorted values.
+ * \param found Called with the address of every match.
+ */
+template<typename Callback>
+inline void scan_aligned_dwords(const uint8_t* begin, const uint8_t* end,
+                                const std::vector<uintptr_t>& values,
+                                Callback&&                    found) {
+    auto check = [&](const uint8_t* at) {
+        auto value = *reinterpret_cast<const uint32_t*>(at);
+        if (std::binary_search(values.begin(), values.end(), value))
+            found(at);
+    };
+
+    auto now = begin;
+    for (; (now + sizeof(uint32_t) <= end) &&
+           (reinterpret_cast<uintptr_t>(now) & (sizeof(__m128i) - 1u));
+         now += sizeof(uint32_t))
+        check(now);
+
+    if (values.size() <= kMaxSimdVtables) {
+        __m128i wanted[kMaxSimdVtables];
+        for (size_t i = 0; i < values.size(); i++)
+            wanted[i] = _mm_set1_epi32(static_cast<int>(values[i]));
+
+        for (; now + sizeof(__m128i) <= end; now += sizeof(__m128i)) {
+            auto block = _mm_load_si128(reinterpret_cast<const __m128i*>(now));
+            auto hits  = _mm_cmpeq_epi32(block, wanted[0]);
+            for (size_t i = 1; i < values.size(); i++)
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi32(block, wanted[i]));
+
+            auto bits = _mm_movemask_ps(_mm_castsi128_ps(hits));
+            for (uint32_t lane = 0; bits; lane++, bits >>= 1) {
+                if (bits & 1)
+                    found(now + lane * sizeof(uint32_t));
+            }
+        }
+    } else {
+        // Unsigned compare through signed one.
+        const auto bias  = _mm_set1_epi32(static_cast<int>(0x80000000u));
+        const auto lower = _mm_set1_epi32(
+            static_cast<int>(values.front() ^ 0x80000000u));
+        const auto upper = _mm_set1_epi32(
+            static_cast<int>(values.back() ^ 0x80000000u));
+
+        for (; now + sizeof(__m128i) <= end; now += sizeof(__m128i)) {
+            auto block = _mm_xor_si128(
+                _mm_load_si128(reinterpret_cast<const __m128i*>(now)), bias);
+            auto outside = _mm_or_si128(_mm_cmplt_epi32(block, lower),
+                                        _mm_cmpgt_epi32(block, upper));
+            auto bits    = ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF;
+
+            for (uint32_t lane = 0; bits; lane++, bits >>= 1) {
+                if (bits & 1)
+                    check(now + lane * sizeof(uint32_t));
+            }
+        }
+    }
+
+    for (; now + sizeof(uint32_t) <= end; now += sizeof(uint32_t))
+        check(now);
+}
+}   // namespace detail
+
+/**
+ * Finds live objects by their vtable pointers.
+ *
+ * Sweeps committed private read-write regions in parallel for aligned
+ * dwords that equal one of the vtables. Memory is read with
+ * \c read_memory_safe \c, so regions released during the sweep are
+ * skipped. Stacks of the sweeping threads (the worker pool and the caller)
+ * are left out, they hold copies of the vtables.
+ *
+ * \param map Region map, refreshed before the sweep.
+ * \param vtables Addresses of the vtables.
+ * \param predicate Validates a candidate object (optional).
+ * \return Sorted addresses of the objects.
+ */
+inline std::vector<uintptr_t>
+find_instances(region_map& map, const std::vector<uintptr_t>& vtables,
+               const instance_predicate_t& predicate = nullptr) {
+    struct chunk {
+        uintptr_t begin;
+        uintptr_t end;
+    };
+
+    std::vector<uintptr_t> sorted(vtables);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    // Unreadable pages are read as zeros.
+    sorted.erase(std::remove(sorted.begin(), sorted.end(), 0u), sorted.end());
+
+    if (sorted.empty())
+        return {};
+
+    region_filter filter;
+    filter.access = kAccessRead | kAccessWrite;
+    filter.types  = static_cast<uint32_t>(RegionType::Private);
+
+    auto& pool = detail::worker_pool::instance();
+
+    // Stacks of the sweeping threads and both lists of the vtables hold the
+    // vtables too.
+    auto excluded = pool.stacks();
+    excluded.push_back(
+        { reinterpret_cast<uintptr_t>(vtables.data()),
+          reinterpret_cast<uintptr_t>(vtables.data() + vtables.size()) });
+    excluded.push_back(
+        { reinterpret_cast<uintptr_t>(sorted.data()),
+          reinterpret_cast<uintptr_t>(sorted.data() + sorted.size()) });
+
+    std::sort(excluded.begin(), excluded.end(),
+              [](const detail::stack_range& a, const detail::stack_range& b) {
+                  return a.begin < b.begin;
+              });
+
+    map.refresh();
+
+    std::vector<chunk> chunks;
+    auto add_chunks = [&](const uintptr_t begin, const uintptr_t end) {
+        for (auto now = begin; now < end; now += kScanChunkSize)
+            chunks.push_back({ now, (std::min)(end, now + kScanChunkSize) });
+    };
+
+    for (auto& region : map.select(filter)) {
+        auto now = region.base;
+        for (auto& skip : excluded) {
+            if (skip.end <= now)
+                continue;
+            if (skip.begin >= region.end())
+                break;
+
+            add_chunks(now, skip.begin);
+            now = (std::max)(now, skip.end);
+        }
+
+        add_chunks(now, region.end());
+    }
+
+    std::vector<std::vector<uintptr_t>> found(chunks.size());
+    pool.parallel_for(chunks.size(), [&](const size_t index) {
+        auto& now = chunks[index];
+
+        alignas(16) uint8_t copy[detail::kInstanceBlockSize];
+        for (auto block = now.begin; block < now.end;
+             block += detail::kInstanceBlockSize) {
+            auto size = (std::min)(now.end - block,
+                                   static_cast<uintptr_t>(sizeof(copy)));
+            detail::read_memory_safe(block, copy, size);
+
+            detail::scan_aligned_dwords(
+                copy, copy + size, sorted, [&](const uint8_t* at) {
+                    auto object = block + (at - copy);
+                    if (!predicate || predicate(object))
+                        found[index].push_back(object);
+                });
+        }
+    });
+
+    // Chunks are sorted, so are the results.
+    std::vector<uintptr_t> result;
+    for (auto& now : found)
+        result.insert(result.end(), now.begin(), now.end());
+
+    return result;
+}
+
+/**
+ * Finds live objects by their vtable pointers.
+ *
+ * \param vtables Addresses of the vtables.
+ * \param predicate Validates a candidate object (optional).
+ * \return Sorted addresses of the objects.
+ */
+inline std::vector<uintptr_t>
+find_instances(const std::vector<uintptr_t>& vtables,
+               const instance_predicate_t&   predicate = nullptr) {
+    region_map map;
+    return find_instances(map, vtables, predicate);
+}
+
+/**
+ * Finds live objects by their vtable pointer.
+ *
+ * \param vtable Address of the vtable.
+ * \param predicate Validates a candidate object (optional).
+ * \return Sorted addresses of the objects.
+ */
+inline std::vector<uintptr_t>
+find_instances(const memory_pointer&       vtable,
+               const instance_predicate_t& predicate = nullptr) {
+    return find_instances(std::vector<uintptr_t>{ vtable.addressof() },
+                          predicate);
+}
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_INSTANCES_HPP_
@@ -0,0 +1,308 @@
+﻿#ifndef MEMWRAPPER_INVOKE_HPP_
+#define MEMWRAPPER_INVOKE_HPP_
+
+namespace memwrapper {
+/**
+ * \brief Maximal number of arguments of a dynamic call.
+ */
+constexpr uint32_t kMaxDynamicArgs = 32u;
+
+/**
+ * \brief Kind of an argument or a return value of a dynamic call. Pointers
+ * and integers up to 32 bits are \c Int32 \c.
+ */
+enum class ValueKind : uint8_t { Void, Int32, Int64, Float, Double };
+
+/**
+ * @brief Argument or return value of a dynamic call.
+ */
+union dynamic_value {
+    uint32_t i32;
+    uint64_t i64;
+    float    f32;
+    double   f64;
+    void*    ptr;
+};   // !union dynamic_value
+
+/**
+ * @brief Signature of a function known at runtime.
+ */
+struct call_signature {
+    detail::CallingConvention convention;
+    ValueKind                 ret;
+    std::vector<ValueKind>    args;
+
+    bool operator==(const call_signature& other) const {
+        return (convention == other.convention) && (ret == other.ret) &&
+               (args == other.args);
+    }
+};   // !struct call_signature
+
+/**
+ * \brief Compiled call: target, arguments and the return value.
+ */
+using dynamic_stub = void(__cdecl*)(uintptr_t, const dynamic_value*,
+                                    dynamic_value*);
+
+namespace detail {
+/**
+ * @brief FNV-1a over the convention and the kinds.
+ */
+struct signature_hash {
+    size_t operator()(const call_signature& signature) const {
+        uint32_t hash = 2166136261u;
+        auto     mix  = [&](const uint8_t byte) {
+            hash = (hash ^ byte) * 16777619u;
+        };
+
+        mix(static_cast<uint8_t>(signature.convention));
+        mix(static_cast<uint8_t>(signature.ret));
+        for (auto kind : signature.args)
+            mix(static_cast<uint8_t>(kind));
+
+        return hash;
+    }
+};   // !struct signature_hash
+
+/**
+ * \param signature Signature.
+ * \return Upper bound of the size of the stub.
+ */
+inline uint32_t get_stub_size(const call_signature& signature) {
+    // Two pushes of 6 bytes per argument, the rest is under 64 bytes.
+    return 64u + 12u * static_cast<uint32_t>(signature.args.size());
+}
+
+/**
+ * Emits a stub that pushes the arguments right to left, loads register
+ * arguments (\c this \c in ecx, first two \c Int32 \c arguments of
+ * fastcall in ecx and edx), calls the target and stores eax, edx:eax or
+ * st(0). The stack is restored from ebp, so caller and callee cleanup
+ * need the same code.
+ *
+ * \param code Output.
+ * \param signature Signature.
+ * \return Is signature supported.
+ */
+inline bool emit_call_stub(asm_allocator&         code,
+                           const call_signature& signature) {
+    auto count = static_cast<uint32_t>(signature.args.size());
+    if (count > kMaxDynamicArgs)
+        return false;
+
+    for (auto kind : signature.args) {
+        if (kind == ValueKind::Void)
+            return false;
+    }
+
+    // Arguments passed in ecx and edx.
+    uint32_t registers[2] = { kMaxDynamicArgs, kMaxDynamicArgs };
+    if (signature.convention == CallingConvention::Thiscall) {
+        if (!count || (signature.args[0] != ValueKind::Int32))
+            return false;
+
+        registers[0] = 0u;
+    } else if (signature.convention == CallingConvention::Fastcall) {
+        uint32_t used = 0u;
+        for (uint32_t i = 0; (i < count) && (used < 2u); i++) {
+            if (signature.args[i] == ValueKind::Int32)
+                registers[used++] = i;
+        }
+    }
+
+    // op [esi + offset], disp8 or disp32.
+    auto emit_load = [&](const uint8_t opcode, const uint8_t reg,
+                         const uint32_t offset) {
+        code.db(opcode);
+        if (offset < 0x80u)
+            code.db(0x46 | (reg << 3)).db(static_cast<uint8_t>(offset));
+        else
+            code.db(0x86 | (reg << 3)).dbvalue(offset);
+    };
+
+    code.push(Registers::Ebp);
+    code.db(0x8B).db(0xEC);   // mov ebp, esp
+    code.push(Registers::Esi);
+    code.mov(Registers::Esi, Registers::Ebp, 0x0C);
+
+    for (uint32_t i = count; i-- > 0;) {
+        if ((i == registers[0]) || (i == registers[1]))
+            continue;
+
+        auto offset = i * sizeof(dynamic_value);
+        auto kind   = signature.args[i];
+
+        // push dword ptr [esi + offset], the high half goes first.
+        if ((kind == ValueKind::Int64) || (kind == ValueKind::Double))
+            emit_load(0xFF, 6u, offset + sizeof(uint32_t));
+
+        emit_load(0xFF, 6u, offset);
+    }
+
+    for (uint8_t reg = 0; reg < 2u; reg++) {
+        if (registers[reg] != kMaxDynamicArgs)
+            emit_load(0x8B, reg + 1u, registers[reg] * sizeof(dynamic_value));
+    }
+
+    code.mov(Registers::Eax, Registers::Ebp, 0x08);
+    code.db(0xFF).db(0xD0);   // call eax
+    code.mov(Registers::Ecx, Registers::Ebp, 0x10);
+
+    switch (signature.ret) {
+        case ValueKind::Int32:
+            code.db(0x89).db(0x01);   // mov [ecx], eax
+            break;
+        case ValueKind::Int64:
+            code.db(0x89).db(0x01);   // mov [ecx], eax
+            code.db(0x89).db(0x51).db(0x04);   // mov [ecx + 4], edx
+            break;
+        case ValueKind::Float:
+            code.db(0xD9).db(0x19);   // fstp dword ptr [ecx]
+            break;
+        case ValueKind::Double:
+            code.db(0xDD).db(0x19);   // fstp qword ptr [ecx]
+            break;
+        default: break;
+    }
+
+    code.db(0x8D).db(0x65).db(0xFC);   // lea esp, [ebp - 4]
+    code.pop(Registers::Esi);
+    code.pop(Registers::Ebp);
+    code.db(0xC3);
+    return true;
+}
+}   // namespace detail
+
+/**
+ * @brief Calls functions with signatures known only at runtime.
+ *
+ * Every signature is compiled once into a stub that moves the arguments
+ * straight from the array, so a call costs about as much as a direct call
+ * plus the pushes. Stubs are cached by signature and packed into shared
+ * pages; they live as long as the invoker.
+ *
+ * @code{.cpp}
+ * memwrapper::call_signature signature{
+ *     memwrapper::detail::CallingConvention::Stdcall,
+ *     memwrapper::ValueKind::Int32,
+ *     { memwrapper::ValueKind::Int32, memwrapper::ValueKind::Double } };
+ *
+ * auto stub = memwrapper::dynamic_invoker::instance().compile(signature);
+ *
+ * memwrapper::dynamic_value args[2], ret;
+ * args[0].i32 = 1;
+ * args[1].f64 = 0.5;
+ * stub(0x00401000, args, &ret);
+ * @endcode
+ */
+class dynamic_invoker {
+  protected:
+    /**
+     * Compiled stubs.
+     */
+    std::unordered_map<call_signature, dynamic_stub, detail::signature_hash>
+        m_stubs;
+    /**
+     * Pages with stubs, the last one is filled.
+     */
+    std::vector<std::unique_ptr<asm_allocator>> m_pages;
+    /**
+     * Guards the cache.
+     */
+    std::mutex m_mutex;
+
+  public:
+    dynamic_invoker(const dynamic_invoker&) = delete;
+    dynamic_invoker(dynamic_invoker&&)      = delete;
+
+    dynamic_invoker() = default;
+
+    /**
+     * Destructor. Releases the stubs.
+     */
+    ~dynamic_invoker() {
+        for (auto& page : m_pages)
+            page->free();
+    }
+
+    /**
+     * \return Invoker of the process.
+     */
+    static dynamic_invoker& instance() {
+        static dynamic_invoker invoker;
+        return invoker;
+    }
+
+    /**
+     * Returns the cached stub of the signature or compiles it.
+     *
+     * \param signature Signature.
+     * \return Stub or nullptr if signature isn't supported.
+     */
+    dynamic_stub compile(const call_signature& signature) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = m_stubs.find(signature);
+        if (it != m_stubs.end())
+            return it->second;
+
+        // Stubs start at 16 bytes.
+        auto size = detail::get_stub_size(signature) + 15u;
+        if (m_pages.empty() || (free_space(*m_pages.back()) < size))
+            m_pages.push_back(std::make_unique<asm_allocator>(
+                (std::max)(size, kPageSize4Kb)));
+
+        auto& page  = *m_pages.back();
+        auto  start = page.get_offset();
+        while (page.now().addressof() & 15u)
+            page.db(0xCC);
+
+        auto stub = reinterpret_cast<dynamic_stub>(page.now().addressof());
+        if (!detail::emit_call_stub(page, signature)) {
+            page.set_offset(start);
+            return nullptr;
+        }
+
+        page.ready();
+        m_stubs.emplace(signature, stub);
+        return stub;
+    }
+
+    /**
+     * Calls the function through the cached stub. Keep the result of
+     * \c compile() \c to skip the lookup on hot paths.
+     *
+     * \param target Address of the function.
+     * \param signature Signature.
+     * \param args Arguments, one per kind of the signature.
+     * \param ret Return value (may be nullptr).
+     * \return Was function called.
+     */
+    bool invoke(const memory_pointer& target, const call_signature& signature,
+                const dynamic_value* args, dynamic_value* ret = nullptr) {
+        auto stub = compile(signature);
+        if (!stub)
+            return false;
+
+        dynamic_value unused;
+        stub(target.addressof(), args, ret ? ret : &unused);
+        return true;
+    }
+
+    /**
+     * \return Number of compiled stubs.
+     */
+    size_t size() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stubs.size();
+    }
+
+  private:
+    static uint32_t free_space(const asm_allocator& page) {
+        return static_cast<uint32_t>(page.end().addressof() + 1u -
+                                     page.now().addressof());
+    }
+};   // !class dynamic_invoker
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_INVOKE_HPP_
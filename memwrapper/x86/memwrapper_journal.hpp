@@ -0,0 +1,267 @@
+﻿#ifndef MEMWRAPPER_JOURNAL_HPP_
+#define MEMWRAPPER_JOURNAL_HPP_
+
+namespace memwrapper {
+/**
+ * @brief Append-only log of old bytes of memory writes.
+ *
+ * While the journal is active, every LLMO write (\c write_memory \c,
+ * \c fill_memory \c, \c copy_memory \c and everything built on them) logs
+ * its address, size, old bytes and a sequence number. Rolling back to a
+ * checkpoint restores all later writes in one \c write_transaction \c:
+ * newest first, so overlapping writes end with the oldest bytes, and one
+ * protection change per region. Writes into pages that were released
+ * since then are skipped. Writes into memwrapper's own trampolines aren't
+ * logged (see \c detail::write_trampoline \c), their pages may be reused by
+ * unrelated code. Only one journal can be active at a time.
+ *
+ * @code{.cpp}
+ * memwrapper::undo_journal journal;
+ * journal.activate();
+ *
+ * journal.checkpoint("clean");
+ * memwrapper::write_memory<uint8_t>(0x00401000, 0xC3);
+ * // ...
+ * journal.rollback("clean");
+ * @endcode
+ */
+class undo_journal {
+    struct entry {
+        uintptr_t address;
+        uint32_t  offset;
+        uint32_t  size;
+        uint64_t  sequence;
+    };
+
+  protected:
+    /**
+     * Logged writes in the order of writing.
+     */
+    std::vector<entry> m_entries;
+    /**
+     * Old bytes of logged writes.
+     */
+    std::vector<uint8_t> m_arena;
+    /**
+     * Sequence numbers of named checkpoints.
+     */
+    std::unordered_map<std::string, uint64_t> m_checkpoints;
+    /**
+     * Sequence number of the next write.
+     */
+    uint64_t m_sequence;
+    /**
+     * Guards the log.
+     */
+    std::mutex m_mutex;
+
+  public:
+    undo_journal(const undo_journal&) = delete;
+    undo_journal(undo_journal&&)      = delete;
+
+    undo_journal()
+        : m_sequence(0u) {}
+
+    /**
+     * Destructor. Stops logging, keeps the memory as is.
+     */
+    ~undo_journal() { deactivate(); }
+
+    /**
+     * Starts logging writes into this journal.
+     *
+     * \return Was journal activated (no other journal is active).
+     */
+    bool activate() {
+        undo_journal* expected = nullptr;
+        return active().compare_exchange_strong(expected, this) ||
+               (expected == this);
+    }
+
+    /**
+     * Stops logging writes into this journal.
+     */
+    void deactivate() {
+        undo_journal* expected = this;
+        active().compare_exchange_strong(expected, nullptr);
+    }
+
+    /**
+     * Logs old bytes of a write, called by LLMO writes of the active journal.
+     *
+     * \param at Destination of the write.
+     * \param size Size of the write.
+     */
+    void record(const memory_pointer& at, const size_t size) {
+        if (!size)
+            return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto offset = static_cast<uint32_t>(m_arena.size());
+        m_arena.resize(m_arena.size() + size);
+        detail::read_memory_safe(at, &m_arena[offset], size);
+
+        m_entries.push_back({ at.addressof(), offset,
+                              static_cast<uint32_t>(size), m_sequence++ });
+    }
+
+    /**
+     * Marks the current state, overwrites a checkpoint with the same name.
+     *
+     * \param name Name of the checkpoint.
+     * \return Sequence number of the checkpoint.
+     */
+    uint64_t checkpoint(const std::string& name) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_checkpoints[name] = m_sequence;
+    }
+
+    /**
+     * Restores the memory to the state of a checkpoint.
+     *
+     * \param name Name of the checkpoint.
+     * \return Was checkpoint found.
+     */
+    bool rollback(const std::string& name) {
+        uint64_t sequence;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            auto it = m_checkpoints.find(name);
+            if (it == m_checkpoints.end())
+                return false;
+
+            sequence = it->second;
+        }
+
+        rollback_to(sequence);
+        return true;
+    }
+
+    /**
+     * Restores writes starting from a sequence number, drops them from the
+     * log and drops later checkpoints.
+     *
+     * \param sequence Sequence number of the first restored write (zero -
+     * everything).
+     * \return Number of restored writes.
+     */
+    size_t rollback_to(const uint64_t sequence) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto first = std::lower_bound(
+            m_entries.begin(), m_entries.end(), sequence,
+            [](const entry& now, const uint64_t value) {
+                return now.sequence < value;
+            });
+
+        // State of pages, queried once per page.
+        std::unordered_map<uintptr_t, bool> committed;
+        auto is_committed = [&](const uintptr_t page) {
+            auto it = committed.find(page);
+            if (it != committed.end())
+                return it->second;
+
+            MEMORY_BASIC_INFORMATION mbi{ 0 };
+            auto state =
+                VirtualQuery(memory_pointer(page), &mbi, sizeof(mbi)) &&
+                (mbi.State == MEM_COMMIT);
+            return committed[page] = state;
+        };
+
+        write_transaction transaction;
+        size_t            restored = 0u;
+
+        for (auto it = m_entries.end(); it != first;) {
+            --it;
+
+            auto page = it->address & ~(kPageSize4Kb - 1u);
+            auto last = (it->address + it->size - 1u) & ~(kPageSize4Kb - 1u);
+
+            bool alive = true;
+            for (; alive && (page <= last); page += kPageSize4Kb)
+                alive = is_committed(page);
+
+            if (!alive)
+                continue;
+
+            transaction.add(it->address, &m_arena[it->offset], it->size);
+            restored++;
+        }
+
+        transaction.commit();
+
+        if (first != m_entries.end())
+            m_arena.resize(first->offset);
+
+        m_entries.erase(first, m_entries.end());
+
+        for (auto it = m_checkpoints.begin(); it != m_checkpoints.end();) {
+            if (it->second > sequence)
+                it = m_checkpoints.erase(it);
+            else
+                ++it;
+        }
+
+        return restored;
+    }
+
+    /**
+     * Drops the log and checkpoints, keeps the memory as is.
+     */
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_entries.clear();
+        m_arena.clear();
+        m_checkpoints.clear();
+    }
+
+    /**
+     * \return Number of logged writes.
+     */
+    size_t size() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    /**
+     * \return Number of logged old bytes.
+     */
+    size_t bytes() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_arena.size();
+    }
+
+    /**
+     * \return Sequence number of the next write.
+     */
+    uint64_t sequence() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_sequence;
+    }
+
+    /**
+     * \return Active journal or nullptr.
+     */
+    static undo_journal* current() {
+        return active().load(std::memory_order_acquire);
+    }
+
+  private:
+    static std::atomic<undo_journal*>& active() {
+        static std::atomic<undo_journal*> journal{ nullptr };
+        return journal;
+    }
+};   // !class undo_journal
+
+namespace detail {
+inline void log_write(const memory_pointer& at, const size_t size) {
+    if (auto journal = undo_journal::current())
+        journal->record(at, size);
+}
+}   // namespace detail
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_JOURNAL_HPP_
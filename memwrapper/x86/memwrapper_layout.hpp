@@ -0,0 +1,344 @@
+﻿#ifndef MEMWRAPPER_LAYOUT_HPP_
+#define MEMWRAPPER_LAYOUT_HPP_
+
+namespace memwrapper {
+/**
+ * @brief Result of a trampoline re-layout.
+ */
+struct layout_report {
+    /**
+     * Relocated trampolines.
+     */
+    size_t hot;
+    /**
+     * Hooks left in place: their hookee doesn't go to their trampoline
+     * (another hook is installed over it) or can't be retargeted atomically.
+     */
+    size_t skipped;
+    /**
+     * Bytes used in the page of relocated trampolines.
+     */
+    size_t bytes;
+    /**
+     * Pages touched by relocated trampolines.
+     */
+    size_t pages;
+    /**
+     * Protection changes made to retarget hookees.
+     */
+    size_t batches;
+};   // !struct layout_report
+
+namespace detail {
+/**
+ * Size of a cache line, instruction fetch sees a store inside one line
+ * either entirely or not at all.
+ */
+constexpr uintptr_t kCacheLineSize = 64u;
+
+/**
+ * @brief New target of a call or jump with rel32.
+ */
+struct rel32_patch {
+    /**
+     * Address of the instruction.
+     */
+    uintptr_t site;
+    /**
+     * Destination the instruction must have, otherwise it isn't patched.
+     */
+    uintptr_t expected;
+    /**
+     * New destination.
+     */
+    uintptr_t target;
+    /**
+     * Output: was instruction retargeted.
+     */
+    bool applied;
+};   // !struct rel32_patch
+
+/**
+ * \param site Address of a call or jump with rel32.
+ * \return Does the operand fit in one cache line.
+ */
+inline bool is_rel32_atomic(const uintptr_t site) {
+    auto operand = site + 1u;
+    return (operand / kCacheLineSize) ==
+           ((operand + sizeof(uint32_t) - 1u) / kCacheLineSize);
+}
+
+/**
+ * Retargets rel32 jumps and calls. Every operand is replaced with one
+ * \c lock cmpxchg8b \c over 8 bytes of its cache line, only while it still
+ * points to the expected destination, so a thread running into it sees
+ * either the old or the new destination. Operands that cross a cache line
+ * aren't patched. Patches are grouped by memory region: one protection
+ * change and one flush per region.
+ *
+ * \param patches Patches, \c applied \c is set for every one.
+ * \return Number of protection changes made.
+ */
+inline size_t retarget_rel32(std::vector<rel32_patch>& patches) {
+    std::vector<size_t> order;
+    for (size_t i = 0; i < patches.size(); i++) {
+        patches[i].applied = false;
+        if (is_rel32_atomic(patches[i].site))
+            order.push_back(i);
+    }
+
+    std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b) {
+        return patches[a].site < patches[b].site;
+    });
+
+    size_t batches = 0u;
+    size_t now     = 0u;
+
+    while (now < order.size()) {
+        MEMORY_BASIC_INFORMATION mbi{ 0 };
+        if (!VirtualQuery(memory_pointer(patches[order[now]].site), &mbi,
+                          sizeof(mbi)) ||
+            (mbi.State != MEM_COMMIT)) {
+            now++;
+            continue;
+        }
+
+        auto region_end = reinterpret_cast<uintptr_t>(mbi.BaseAddress) +
+                          mbi.RegionSize;
+
+        // Collecting patches of the same region.
+        auto first = now;
+        while ((now < order.size()) &&
+               (patches[order[now]].site + kJumpSize <= region_end))
+            now++;
+
+        // The instruction crosses the region end.
+        if (now == first) {
+            now++;
+            continue;
+        }
+
+        auto begin = patches[order[first]].site;
+        auto end   = patches[order[now - 1u]].site + kJumpSize;
+
+        scoped_unprotect unprotect(begin, end - begin);
+        if (!unprotect.good())
+            continue;
+
+        for (auto i = first; i < now; i++) {
+            auto& patch    = patches[order[i]];
+            auto  expected = get_relative_address(patch.expected, patch.site);
+            auto  operand  = get_relative_address(patch.target, patch.site);
+
+            // 8 bytes with the operand inside its cache line.
+            auto line_end = ((patch.site + 1u) | (kCacheLineSize - 1u)) + 1u;
+            auto window   = (std::min)(patch.site + 1u, line_end - 8u);
+            auto shift    = patch.site + 1u - window;
+
+            auto pointer = reinterpret_cast<volatile LONG64*>(window);
+            auto old     = *pointer;
+
+            for (;;) {
+                uint32_t current;
+                std::memcpy(&current, reinterpret_cast<uint8_t*>(&old) + shift,
+                            sizeof(current));
+                if (current != expected)
+                    break;
+
+                auto next = old;
+                std::memcpy(reinterpret_cast<uint8_t*>(&next) + shift,
+                            &operand, sizeof(operand));
+
+                auto seen = InterlockedCompareExchange64(pointer, next, old);
+                if (seen == old) {
+                    patch.applied = true;
+                    break;
+                }
+
+                old = seen;
+            }
+        }
+
+        flush_memory(begin, end - begin);
+        batches++;
+    }
+
+    return batches;
+}
+}   // namespace detail
+
+/**
+ * @brief Packs trampolines of the hottest hooks together.
+ *
+ * Every \c memhook \c trampoline takes its own page. \c relayout() \c reads
+ * call counts of the added hooks and regenerates the hottest trampolines
+ * contiguously (hottest first, 16-byte aligned) in one new allocation, so
+ * hot paths share a few cache lines and one page instead of one page per
+ * hook. Hookees are then retargeted with \c detail::retarget_rel32 \c.
+ * A hook whose hookee doesn't go to its trampoline any more (another hook
+ * is installed over it) keeps its old trampoline.
+ *
+ * Old trampolines are kept until the layout is destroyed, since threads
+ * may still run in them. Hooks must outlive the layout and must not be
+ * installed or removed concurrently with \c relayout() \c.
+ *
+ * @code{.cpp}
+ * memwrapper::trampoline_layout layout;
+ * layout.add(*hook_a);
+ * layout.add(*hook_b);
+ *
+ * // after a warmup
+ * auto report = layout.relayout(40);
+ * @endcode
+ */
+class trampoline_layout {
+    using page_t = std::shared_ptr<asm_allocator>;
+
+    struct hook_entry {
+        std::function<uint32_t()>                     calls;
+        std::function<void()>                         reset;
+        std::function<uintptr_t()>                    hookee;
+        std::function<uintptr_t()>                    trampoline;
+        std::function<page_t(const page_t&)>          relocate;
+        std::function<void(const page_t&, uintptr_t)> restore;
+    };
+
+    struct moved_hook {
+        size_t    index;
+        page_t    page;
+        uintptr_t trampoline;
+    };
+
+  protected:
+    /**
+     * Added hooks.
+     */
+    std::vector<hook_entry> m_hooks;
+    /**
+     * Pages of replaced trampolines.
+     */
+    std::vector<page_t> m_retired;
+
+  public:
+    trampoline_layout(const trampoline_layout&) = delete;
+    trampoline_layout(trampoline_layout&&)      = delete;
+
+    trampoline_layout() = default;
+
+    /**
+     * Adds a hook.
+     *
+     * \param hook Hook.
+     */
+    template<typename Function>
+    void add(memhook<Function>& hook) {
+        m_hooks.push_back(
+            { [&hook]() { return hook.installed() ? hook.calls() : 0u; },
+              [&hook]() { hook.reset_calls(); },
+              [&hook]() { return hook.hookee(); },
+              [&hook]() { return hook.trampoline(); },
+              [&hook](const page_t& page) {
+                  return hook.relocate_trampoline(page);
+              },
+              [&hook](const page_t& page, const uintptr_t at) {
+                  hook.restore_trampoline(page, at);
+              } });
+    }
+
+    /**
+     * Relocates trampolines of the hottest hooks.
+     *
+     * \param max_hot Maximal number of relocated trampolines.
+     * \param min_calls Minimal number of calls of a hot hook.
+     * \param reset Reset call counts of all hooks afterwards.
+     * \return Report of the pass.
+     */
+    layout_report relayout(const size_t   max_hot   = 64u,
+                           const uint32_t min_calls = 1u,
+                           const bool     reset     = true) {
+        layout_report report{};
+
+        std::vector<std::pair<uint32_t, size_t>> order;
+        for (size_t i = 0; i < m_hooks.size(); i++) {
+            auto calls = m_hooks[i].calls();
+            if (calls >= (std::max)(min_calls, 1u))
+                order.push_back({ calls, i });
+        }
+
+        std::sort(order.begin(), order.end(),
+                  [](const std::pair<uint32_t, size_t>& a,
+                     const std::pair<uint32_t, size_t>& b) {
+                      return a.first > b.first;
+                  });
+
+        if (order.size() > max_hot)
+            order.resize(max_hot);
+
+        if (order.empty())
+            return report;
+
+        auto page = detail::make_code_page(
+            static_cast<uint32_t>(order.size()) * kMaxTrampolineSize);
+
+        std::vector<moved_hook>          moved;
+        std::vector<detail::rel32_patch> patches;
+        for (auto& now : order) {
+            auto& hook = m_hooks[now.second];
+            auto  from = hook.trampoline();
+            auto  site = hook.hookee();
+
+            if (!detail::is_rel32_atomic(site)) {
+                report.skipped++;
+                continue;
+            }
+
+            while (page->now().addressof() & 15u)
+                page->db(0xCC);
+
+            auto old = hook.relocate(page);
+            if (!old)
+                continue;
+
+            moved.push_back({ now.second, std::move(old), from });
+            patches.push_back({ site, from, hook.trampoline(), false });
+        }
+
+        report.batches = detail::retarget_rel32(patches);
+
+        // The hookee still goes to the old trampoline on failure.
+        for (size_t i = 0; i < moved.size(); i++) {
+            auto& now = moved[i];
+            if (patches[i].applied) {
+                m_retired.push_back(std::move(now.page));
+                report.hot++;
+            } else {
+                m_hooks[now.index].restore(now.page, now.trampoline);
+                report.skipped++;
+            }
+        }
+
+        auto begin = page->begin().addressof();
+        auto end   = page->now().addressof();
+
+        // Without relocated hooks the page is released right away.
+        report.bytes = report.hot ? end - begin : 0u;
+        report.pages = report.bytes ? ((end - 1u) / kPageSize4Kb -
+                                       begin / kPageSize4Kb + 1u)
+                                    : 0u;
+
+        if (reset) {
+            for (auto& hook : m_hooks)
+                hook.reset();
+        }
+
+        return report;
+    }
+
+    /**
+     * \return Number of added hooks.
+     */
+    size_t size() const { return m_hooks.size(); }
+};   // !class trampoline_layout
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_LAYOUT_HPP_
@@ -35,6 +35,15 @@ inline uint32_t convert_memory_protection_constant(MemoryProt prot) {
     default: return 0;
     }
 }
+
+/**
+ * Records old bytes of a write into the active \c undo_journal \c (see
+ * memwrapper_journal.hpp).
+ *
+ * \param at Destination of the write.
+ * \param size Size of the write.
+ */
+inline void log_write(const memory_pointer& at, const size_t size);
 }   // namespace detail
 
 /**
@@ -128,6 +137,8 @@ template<typename T>
 inline void write_memory(const memory_pointer& at, const T value) {
     // Unprotecting.
     scoped_unprotect unprotect(at, sizeof(T));
+    // Logging old value.
+    detail::log_write(at, sizeof(T));
     // Writing new value.
     *at.cast<T*>() = value;
     // Flushing information about this region in CPU.
@@ -145,6 +156,8 @@ inline void fill_memory(const memory_pointer& at, const int value,
                         const size_t size) {
     // Unprotecting.
     scoped_unprotect unprotect(at, size);
+    // Logging old value.
+    detail::log_write(at, size);
     // Do memset.
     std::memset(at, value, size);
     // Flushing information about this region in CPU.
@@ -162,12 +175,64 @@ inline void copy_memory(const memory_pointer& dst, const memory_pointer& src,
                         const size_t size) {
     // Unprotecting the memory region.
     scoped_unprotect unprotect(dst, size);
+    // Logging old value.
+    detail::log_write(dst, size);
     // Copying new value to the memory region.
     std::memcpy(dst, src, size);
     // Flushing information about this region in CPU.
     flush_memory(dst, size);
 }
 
+namespace detail {
+/**
+ * Copies original bytes into a backup buffer of the caller. Unlike
+ * \c copy_memory \c it isn't logged, since it writes no patched memory.
+ *
+ * \param backup Backup buffer.
+ * \param src Memory region.
+ * \param size Size of the memory region.
+ */
+inline void backup_memory(const memory_pointer& backup,
+                          const memory_pointer& src, const size_t size) {
+    // Unprotecting the source.
+    scoped_unprotect unprotect(src, size);
+    // Copying the original value.
+    std::memcpy(backup, src, size);
+}
+
+/**
+ * Copies bytes into memwrapper's own trampoline code. Unlike
+ * \c copy_memory \c it isn't logged: trampoline pages are released with
+ * their hooks and may be reused by other code, a journal rollback must
+ * never write into them.
+ *
+ * \param dst Destination inside a trampoline.
+ * \param src Source of the bytes.
+ * \param size Number of bytes.
+ */
+inline void write_trampoline(const memory_pointer& dst,
+                             const memory_pointer& src, const size_t size) {
+    scoped_unprotect unprotect(dst, size);
+    std::memcpy(dst, src, size);
+    flush_memory(dst, size);
+}
+
+/**
+ * Fills memwrapper's own trampoline code, isn't logged (see
+ * \c write_trampoline \c).
+ *
+ * \param dst Destination inside a trampoline.
+ * \param value Byte that will be written.
+ * \param size Number of bytes.
+ */
+inline void fill_trampoline(const memory_pointer& dst, const int value,
+                            const size_t size) {
+    scoped_unprotect unprotect(dst, size);
+    std::memset(dst, value, size);
+    flush_memory(dst, size);
+}
+}   // namespace detail
+
 /**
  * Compares an information from one memory region with other.
  *
@@ -299,6 +364,8 @@ class scoped_write {
 
         // Installing new value.
         write_memory<T>(at, value);
+        // Registering the patched range.
+        detail::ownership_registry::instance().add(at, sizeof(T));
     }
 
     ~scoped_write() { restore(); }
@@ -320,6 +387,8 @@ class scoped_write {
 
         // Installing new value.
         write_memory<T>(at, value);
+        // Registering the patched range.
+        detail::ownership_registry::instance().add(at, sizeof(T));
     }
 
     /**
@@ -327,8 +396,11 @@ class scoped_write {
      */
     void restore() {
         // If backup was initialized.
-        if (m_initialized)
+        if (m_initialized) {
             write_memory<T>(m_pointer, m_data);
+            detail::ownership_registry::instance().remove(m_pointer,
+                                                          sizeof(T));
+        }
 
         // Marking as uninitialized.
         m_initialized = false;
@@ -368,9 +440,11 @@ class scoped_copy {
     scoped_copy(const memory_pointer& at, const memory_pointer& data)
         : m_pointer(at) {
         // Copying previous data for backup.
-        copy_memory(m_buf, at, bufsize);
+        detail::backup_memory(m_buf, at, bufsize);
         // Installing new data.
         copy_memory(at, data, bufsize);
+        // Registering the patched range.
+        detail::ownership_registry::instance().add(at, bufsize);
 
         // Marking as initialized.
         m_initialized = true;
@@ -389,9 +463,11 @@ class scoped_copy {
         m_pointer = at;
 
         // Copying previous data for backup.
-        copy_memory(m_buf, at, bufsize);
+        detail::backup_memory(m_buf, at, bufsize);
         // Installing new data.
         copy_memory(at, data, bufsize);
+        // Registering the patched range.
+        detail::ownership_registry::instance().add(at, bufsize);
 
         // Marking as initialized.
         m_initialized = true;
@@ -402,9 +478,11 @@ class scoped_copy {
      */
     void restore() {
         // If backup was initialized.
-        if (m_initialized)
+        if (m_initialized) {
             copy_memory(m_pointer, m_buf,
                         bufsize);   // Copying backup to the pointer.
+            detail::ownership_registry::instance().remove(m_pointer, bufsize);
+        }
 
         // Marking as uninitialized.
         m_initialized = false;
@@ -444,9 +522,11 @@ class scoped_fill {
     scoped_fill(const memory_pointer& at, const int value)
         : m_pointer(at) {
         // Copying previous data for backup.
-        copy_memory(m_buf, at, bufsize);
+        detail::backup_memory(m_buf, at, bufsize);
         // Fills new data.
         fill_memory(at, value, bufsize);
+        // Registering the patched range.
+        detail::ownership_registry::instance().add(at, bufsize);
         // Marking as installed.
         m_initialized = true;
     }
@@ -464,9 +544,11 @@ class scoped_fill {
         m_pointer = at;
 
         // Copying previous data for backup.
-        copy_memory(m_buf, at, bufsize);
+        detail::backup_memory(m_buf, at, bufsize);
         // Filling new data.
         fill_memory(at, value, bufsize);
+        // Registering the patched range.
+        detail::ownership_registry::instance().add(at, bufsize);
 
         // Marking as installed.
         m_initialized = true;
@@ -474,9 +556,11 @@ class scoped_fill {
 
     void restore() {
         // If backup was initialized.
-        if (m_initialized)
+        if (m_initialized) {
             copy_memory(m_pointer, m_buf,
                         bufsize);   // Restoring previous data.
+            detail::ownership_registry::instance().remove(m_pointer, bufsize);
+        }
 
         // Marking as uninitialized.
         m_initialized = false;
@@ -503,6 +587,10 @@ class scoped_patch_unit {
      * Backup.
      */
     byte_vector m_original;
+    /**
+     * Is patch installed.
+     */
+    bool m_installed;
 
   public:
     scoped_patch_unit()                         = delete;
@@ -520,7 +608,8 @@ class scoped_patch_unit {
                       const byte_vector& original)
         : m_replacement(replacement)
         , m_original(original)
-        , m_address(GetModuleHandle(mod.data()) + offset.addressof()) {}
+        , m_address(GetModuleHandle(mod.data()) + offset.addressof())
+        , m_installed(false) {}
 
     /**
      * \param mod Module there will be patch installed.
@@ -530,13 +619,15 @@ class scoped_patch_unit {
      */
     scoped_patch_unit(std::string_view mod, const memory_pointer& offset,
                       const byte_vector& replacement)
-        : m_replacement(replacement) {
+        : m_replacement(replacement)
+        , m_installed(false) {
         auto handle = reinterpret_cast<uint32_t>(GetModuleHandle(mod.data()));
 
         m_address = handle + offset.addressof();
         m_original.resize(replacement.size());
 
-        copy_memory(m_original.data(), m_address, m_original.size());
+        detail::backup_memory(m_original.data(), m_address,
+                              m_original.size());
     }
 
     /**
@@ -549,7 +640,8 @@ class scoped_patch_unit {
                       const byte_vector&    original)
         : m_address(address)
         , m_replacement(replacement)
-        , m_original(original) {}
+        , m_original(original)
+        , m_installed(false) {}
 
     /**
      * \param address Address of the core module there will be patch installed.
@@ -558,10 +650,12 @@ class scoped_patch_unit {
     scoped_patch_unit(const memory_pointer& address,
                       const byte_vector&    replacement)
         : m_address(address)
-        , m_replacement(replacement) {
+        , m_replacement(replacement)
+        , m_installed(false) {
         m_original.resize(replacement.size());
 
-        copy_memory(m_original.data(), m_address, m_original.size());
+        detail::backup_memory(m_original.data(), m_address,
+                              m_original.size());
     }
 
     /**
@@ -569,6 +663,13 @@ class scoped_patch_unit {
      */
     void install() {
         copy_memory(m_address, m_replacement.data(), m_replacement.size());
+
+        // Registering the patched range once.
+        if (!m_installed)
+            detail::ownership_registry::instance().add(m_address,
+                                                       m_replacement.size());
+
+        m_installed = true;
     }
 
     /**
@@ -576,6 +677,12 @@ class scoped_patch_unit {
      */
     void restore() {
         copy_memory(m_address, m_original.data(), m_original.size());
+
+        if (m_installed)
+            detail::ownership_registry::instance().remove(
+                m_address, m_replacement.size());
+
+        m_installed = false;
     }
 };   // !class scoped_patch_unit
 
@@ -0,0 +1,477 @@
+﻿#ifndef MEMWRAPPER_MODULES_HPP_
+#define MEMWRAPPER_MODULES_HPP_
+
+namespace memwrapper {
+/**
+ * \brief Capacity of the queue of module events.
+ */
+constexpr uint32_t kModuleEventQueueSize = 256u;
+/**
+ * \brief Maximal length of a module name in an event.
+ */
+constexpr uint32_t kMaxModuleEventName = 64u;
+
+enum class ModuleEventType { Load, Unload };
+
+/**
+ * @brief Load or unload of a module.
+ */
+struct module_event {
+    ModuleEventType type;
+    /**
+     * Base address of the module.
+     */
+    uintptr_t base;
+    /**
+     * Size of the image.
+     */
+    uint32_t size;
+    /**
+     * File name of the module (example.dll).
+     */
+    char name[kMaxModuleEventName];
+};   // !struct module_event
+
+using module_handler_t = std::function<void(const module_event&)>;
+using module_scan_handler_t =
+    std::function<void(const module_scan_result&)>;
+
+namespace detail {
+/**
+ * Reasons and data of loader notifications (ntdll, not in SDK headers).
+ */
+constexpr ULONG kLdrNotificationLoaded   = 1u;
+constexpr ULONG kLdrNotificationUnloaded = 2u;
+
+struct ldr_unicode_string {
+    USHORT length;
+    USHORT maximum_length;
+    PWSTR  buffer;
+};   // !struct ldr_unicode_string
+
+struct ldr_notification_data {
+    ULONG                     flags;
+    const ldr_unicode_string* full_name;
+    const ldr_unicode_string* base_name;
+    PVOID                     base;
+    ULONG                     size;
+};   // !struct ldr_notification_data
+
+using ldr_notification_t = void(NTAPI*)(ULONG, const ldr_notification_data*,
+                                        PVOID);
+using ldr_register_t = NTSTATUS(NTAPI*)(ULONG, ldr_notification_t, PVOID,
+                                        PVOID*);
+using ldr_unregister_t = NTSTATUS(NTAPI*)(PVOID);
+
+/**
+ * @brief Bounded lock-free queue with many producers and one consumer.
+ *
+ * Every cell carries a sequence number: a producer claims a position with
+ * a CAS on the tail and publishes the cell by bumping its sequence, the
+ * consumer frees the cell for the next lap. Nothing allocates, so pushing
+ * is safe under the loader lock.
+ */
+template<typename T, uint32_t Capacity>
+class mpsc_ring {
+    static_assert(!(Capacity & (Capacity - 1u)),
+                  "Capacity must be a power of two");
+
+    struct cell {
+        std::atomic<uint32_t> sequence;
+        T                     value;
+    };
+
+  protected:
+    /**
+     * Cells of the queue.
+     */
+    cell m_cells[Capacity];
+    /**
+     * Next position of producers.
+     */
+    std::atomic<uint32_t> m_tail;
+    /**
+     * Next position of the consumer.
+     */
+    uint32_t m_head;
+
+  public:
+    mpsc_ring(const mpsc_ring&) = delete;
+    mpsc_ring(mpsc_ring&&)      = delete;
+
+    mpsc_ring()
+        : m_tail(0u)
+        , m_head(0u) {
+        for (uint32_t i = 0; i < Capacity; i++)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /**
+     * Adds a value, from any thread.
+     *
+     * \param value Value.
+     * \return Was value added (queue isn't full).
+     */
+    bool push(const T& value) {
+        auto position = m_tail.load(std::memory_order_relaxed);
+
+        for (;;) {
+            auto& now  = m_cells[position % Capacity];
+            auto  diff = static_cast<int32_t>(
+                now.sequence.load(std::memory_order_acquire) - position);
+
+            if (diff < 0)
+                return false;
+
+            if (!diff) {
+                if (m_tail.compare_exchange_weak(position, position + 1u,
+                                                 std::memory_order_relaxed)) {
+                    now.value = value;
+                    now.sequence.store(position + 1u,
+                                       std::memory_order_release);
+                    return true;
+                }
+            } else {
+                position = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * Takes the oldest value, from the consumer thread only.
+     *
+     * \param out Value.
+     * \return Was queue not empty.
+     */
+    bool pop(T& out) {
+        auto& now = m_cells[m_head % Capacity];
+        if (now.sequence.load(std::memory_order_acquire) != m_head + 1u)
+            return false;
+
+        out = now.value;
+        now.sequence.store(m_head + Capacity, std::memory_order_release);
+        m_head++;
+        return true;
+    }
+};   // !class mpsc_ring<T, Capacity>
+}   // namespace detail
+
+/**
+ * @brief Stream of module loads and unloads without polling the module
+ * list.
+ *
+ * The loader notification (\c LdrRegisterDllNotification \c) only pushes
+ * the event into a lock-free queue and signals an event object, since it
+ * runs under the loader lock. \c poll() \c, called from the thread that
+ * owns the watcher, updates the module table in place, calls subscribers
+ * and runs signature scans that wait for a module. If the queue overflows,
+ * the table is rebuilt and the difference is reported as events.
+ *
+ * @code{.cpp}
+ * memwrapper::module_watcher watcher;
+ * watcher.subscribe([](const memwrapper::module_event& event) {
+ *     // ...
+ * });
+ *
+ * memwrapper::pattern_set patterns;
+ * patterns.add("\x55\x8B\xEC", "xxx");
+ * watcher.scan_on_load("plugin.dll", patterns,
+ *                      [](const memwrapper::module_scan_result& result) {
+ *                          // ...
+ *                      });
+ *
+ * // once per frame, or blocking in a worker thread
+ * watcher.poll(INFINITE);
+ * @endcode
+ */
+class module_watcher {
+    struct pending_scan {
+        std::string           name;
+        pattern_set           patterns;
+        module_scan_handler_t handler;
+    };
+
+  protected:
+    /**
+     * Events from the loader.
+     */
+    detail::mpsc_ring<module_event, kModuleEventQueueSize> m_queue;
+    /**
+     * Loaded modules sorted by base address.
+     */
+    std::vector<module_info> m_modules;
+    /**
+     * Subscribers with their ids.
+     */
+    std::vector<std::pair<uint32_t, module_handler_t>> m_subscribers;
+    /**
+     * Scans that wait for their module.
+     */
+    std::vector<pending_scan> m_scans;
+    /**
+     * Events lost to a full queue.
+     */
+    std::atomic<uint32_t> m_dropped;
+    /**
+     * Lost events already handled by a rebuild.
+     */
+    uint32_t m_resynced;
+    /**
+     * Id of the next subscriber.
+     */
+    uint32_t m_next_id;
+    /**
+     * Signaled on every event.
+     */
+    HANDLE m_signal;
+    /**
+     * Cookie of the loader notification.
+     */
+    PVOID m_cookie;
+
+  public:
+    module_watcher(const module_watcher&) = delete;
+    module_watcher(module_watcher&&)      = delete;
+
+    /**
+     * Constructor. Starts watching and caches loaded modules.
+     */
+    module_watcher()
+        : m_dropped(0u)
+        , m_resynced(0u)
+        , m_next_id(1u)
+        , m_signal(CreateEvent(NULL, FALSE, FALSE, NULL))
+        , m_cookie(nullptr) {
+        auto register_notification =
+            reinterpret_cast<detail::ldr_register_t>(GetProcAddress(
+                GetModuleHandle("ntdll.dll"), "LdrRegisterDllNotification"));
+
+        // Registering first, modules loaded in between are merged.
+        if (register_notification)
+            register_notification(0u, &notify, this, &m_cookie);
+
+        m_modules = loaded_modules();
+    }
+
+    /**
+     * Destructor. Stops watching, waits for running notifications.
+     */
+    ~module_watcher() {
+        auto unregister_notification =
+            reinterpret_cast<detail::ldr_unregister_t>(GetProcAddress(
+                GetModuleHandle("ntdll.dll"), "LdrUnregisterDllNotification"));
+
+        if (m_cookie && unregister_notification)
+            unregister_notification(m_cookie);
+
+        if (m_signal)
+            CloseHandle(m_signal);
+    }
+
+    /**
+     * Adds a subscriber, called from \c poll() \c.
+     *
+     * \param handler Subscriber.
+     * \return Id of the subscriber.
+     */
+    uint32_t subscribe(module_handler_t handler) {
+        m_subscribers.push_back({ m_next_id, std::move(handler) });
+        return m_next_id++;
+    }
+
+    /**
+     * Removes a subscriber.
+     *
+     * \param id Id of the subscriber.
+     */
+    void unsubscribe(const uint32_t id) {
+        m_subscribers.erase(
+            std::remove_if(m_subscribers.begin(), m_subscribers.end(),
+                           [id](const auto& now) { return now.first == id; }),
+            m_subscribers.end());
+    }
+
+    /**
+     * Scans a module once it's loaded, right now if it's loaded already.
+     *
+     * \param name Module to scan (example.dll).
+     * \param patterns Patterns to search for.
+     * \param handler Receiver of matches.
+     */
+    void scan_on_load(std::string_view name, const pattern_set& patterns,
+                      module_scan_handler_t handler) {
+        for (auto& now : m_modules) {
+            if (detail::equal_module_names(now.name, name)) {
+                handler(scan_modules(patterns, { now })[0]);
+                return;
+            }
+        }
+
+        m_scans.push_back({ std::string(name), patterns, std::move(handler) });
+    }
+
+    /**
+     * Handles queued events.
+     *
+     * \param timeout Milliseconds to wait for an event.
+     * \return Number of handled events.
+     */
+    size_t poll(const DWORD timeout = 0u) {
+        if (m_signal)
+            WaitForSingleObject(m_signal, timeout);
+
+        size_t       count = 0u;
+        module_event event;
+
+        while (m_queue.pop(event)) {
+            dispatch(event);
+            count++;
+        }
+
+        auto dropped = m_dropped.load(std::memory_order_acquire);
+        if (dropped != m_resynced) {
+            m_resynced = dropped;
+            count += resync();
+        }
+
+        return count;
+    }
+
+    /**
+     * \param at Address.
+     * \return Module that contains the address or nullptr.
+     */
+    const module_info* find(const uintptr_t at) const {
+        auto it = std::upper_bound(m_modules.begin(), m_modules.end(), at,
+                                   [](const uintptr_t    address,
+                                      const module_info& module) {
+                                       return address < module.base;
+                                   });
+
+        if (it == m_modules.begin())
+            return nullptr;
+
+        --it;
+        return (at < it->base + it->size) ? &*it : nullptr;
+    }
+
+    /**
+     * \return Loaded modules sorted by base address.
+     */
+    const std::vector<module_info>& modules() const { return m_modules; }
+    /**
+     * \return Number of events lost to a full queue.
+     */
+    uint32_t dropped() const { return m_dropped.load(); }
+    /**
+     * \return Is loader notification registered.
+     */
+    bool good() const { return (m_cookie != nullptr); }
+
+  private:
+    static void NTAPI notify(ULONG                                reason,
+                             const detail::ldr_notification_data* data,
+                             PVOID                                context) {
+        auto watcher = static_cast<module_watcher*>(context);
+
+        module_event event;
+        event.type = (reason == detail::kLdrNotificationLoaded)
+                         ? ModuleEventType::Load
+                         : ModuleEventType::Unload;
+        event.base = reinterpret_cast<uintptr_t>(data->base);
+        event.size = data->size;
+
+        // Only ASCII names are kept as is.
+        uint32_t length = 0u;
+        if (data->base_name && data->base_name->buffer) {
+            auto source = data->base_name->length / sizeof(wchar_t);
+            for (; (length < source) && (length + 1u < kMaxModuleEventName);
+                 length++) {
+                auto c = data->base_name->buffer[length];
+                event.name[length] = (c < 0x80) ? static_cast<char>(c) : '?';
+            }
+        }
+
+        event.name[length] = '\0';
+
+        if (!watcher->m_queue.push(event))
+            watcher->m_dropped.fetch_add(1u, std::memory_order_release);
+
+        SetEvent(watcher->m_signal);
+    }
+
+    void dispatch(const module_event& event) {
+        auto it = std::lower_bound(m_modules.begin(), m_modules.end(),
+                                   event.base,
+                                   [](const module_info& module,
+                                      const uintptr_t    address) {
+                                       return module.base < address;
+                                   });
+        auto known = (it != m_modules.end()) && (it->base == event.base);
+
+        module_info info{ event.name, event.base, event.size };
+        if (event.type == ModuleEventType::Load) {
+            if (known)
+                *it = info;
+            else
+                m_modules.insert(it, info);
+        } else if (known) {
+            m_modules.erase(it);
+        }
+
+        for (auto& now : m_subscribers)
+            now.second(event);
+
+        if (event.type == ModuleEventType::Load)
+            run_scans(info);
+    }
+
+    void run_scans(const module_info& module) {
+        for (size_t i = 0; i < m_scans.size();) {
+            if (!detail::equal_module_names(m_scans[i].name, module.name)) {
+                i++;
+                continue;
+            }
+
+            auto scan = std::move(m_scans[i]);
+            m_scans.erase(m_scans.begin() + i);
+            scan.handler(scan_modules(scan.patterns, { module })[0]);
+        }
+    }
+
+    size_t resync() {
+        auto current = loaded_modules();
+        auto old     = m_modules;
+        auto count   = 0u;
+
+        auto by_base = [](const module_info& a, const module_info& b) {
+            return a.base < b.base;
+        };
+
+        auto report = [&](const module_info& module, ModuleEventType type) {
+            module_event event{ type, module.base, module.size, {} };
+            module.name.copy(event.name, kMaxModuleEventName - 1u);
+            dispatch(event);
+            count++;
+        };
+
+        // Unloaded modules first, a new module may reuse the base.
+        for (auto& module : old) {
+            if (!std::binary_search(current.begin(), current.end(), module,
+                                    by_base))
+                report(module, ModuleEventType::Unload);
+        }
+
+        for (auto& module : current) {
+            if (!std::binary_search(old.begin(), old.end(), module, by_base))
+                report(module, ModuleEventType::Load);
+        }
+
+        // Names and sizes of the snapshot are more complete.
+        m_modules = std::move(current);
+        return count;
+    }
+};   // !class module_watcher
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_MODULES_HPP_
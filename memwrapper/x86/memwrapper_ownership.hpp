@@ -0,0 +1,110 @@
+﻿#ifndef MEMWRAPPER_OWNERSHIP_HPP_
+#define MEMWRAPPER_OWNERSHIP_HPP_
+
+namespace memwrapper {
+/**
+ * @brief Memory range modified by memwrapper itself.
+ */
+struct owned_range {
+    uintptr_t begin;
+    uintptr_t end;
+};   // !struct owned_range
+
+namespace detail {
+/**
+ * @brief Process-wide registry of ranges that are currently patched or
+ * hooked by memwrapper.
+ */
+class ownership_registry {
+  protected:
+    /**
+     * Guards \c m_ranges \c.
+     */
+    mutable std::mutex m_mutex;
+    /**
+     * Registered ranges. The same range may be registered several times.
+     */
+    std::vector<owned_range> m_ranges;
+
+  public:
+    /**
+     * \return The only instance of the registry.
+     */
+    static ownership_registry& instance() {
+        static ownership_registry registry;
+        return registry;
+    }
+
+    /**
+     * Registers a modified range.
+     *
+     * \param at Start of the range.
+     * \param size Size of the range.
+     */
+    void add(const memory_pointer& at, const size_t size) {
+        if (!size)
+            return;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_ranges.push_back({ at.addressof(), at.addressof() + size });
+    }
+
+    /**
+     * Unregisters a range registered by \c add \c.
+     *
+     * \param at Start of the range.
+     * \param size Size of the range.
+     */
+    void remove(const memory_pointer& at, const size_t size) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto it = std::find_if(m_ranges.begin(), m_ranges.end(),
+                               [&](const owned_range& range) {
+                                   return (range.begin == at.addressof()) &&
+                                          (range.end == at.addressof() + size);
+                               });
+
+        if (it != m_ranges.end())
+            m_ranges.erase(it);
+    }
+
+    /**
+     * \return Sorted copy of all registered ranges.
+     */
+    std::vector<owned_range> snapshot() const {
+        std::vector<owned_range> result;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            result = m_ranges;
+        }
+
+        std::sort(result.begin(), result.end(),
+                  [](const owned_range& a, const owned_range& b) {
+                      return a.begin < b.begin;
+                  });
+        return result;
+    }
+};   // !class ownership_registry
+}   // namespace detail
+
+/**
+ * Checks is memory region modified by memwrapper hooks or patches.
+ *
+ * \param at Start of the region.
+ * \param size Size of the region.
+ * \return True if any byte of the region is owned.
+ */
+inline bool is_owned_memory(const memory_pointer& at, const size_t size) {
+    auto begin = at.addressof();
+    auto end   = begin + size;
+
+    for (auto& range : detail::ownership_registry::instance().snapshot()) {
+        if ((range.begin < end) && (begin < range.end))
+            return true;
+    }
+
+    return false;
+}
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_OWNERSHIP_HPP_
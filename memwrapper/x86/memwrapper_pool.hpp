@@ -0,0 +1,212 @@
+﻿#ifndef MEMWRAPPER_POOL_HPP_
+#define MEMWRAPPER_POOL_HPP_
+
+namespace memwrapper {
+namespace detail {
+/**
+ * @brief Reserved stack of a thread.
+ */
+struct stack_range {
+    uintptr_t begin;
+    uintptr_t end;
+};   // !struct stack_range
+
+/**
+ * \return Whole reserved stack of the current thread, including pages
+ * that aren't committed yet.
+ */
+inline stack_range current_thread_stack() {
+    auto tib = reinterpret_cast<const NT_TIB*>(NtCurrentTeb());
+
+    MEMORY_BASIC_INFORMATION mbi{ 0 };
+    VirtualQuery(tib->StackLimit, &mbi, sizeof(mbi));
+
+    auto begin = mbi.AllocationBase ? mbi.AllocationBase : tib->StackLimit;
+    return { reinterpret_cast<uintptr_t>(begin),
+             reinterpret_cast<uintptr_t>(tib->StackBase) };
+}
+
+/**
+ * @brief Process-wide pool of worker threads shared by all parallel sweeps.
+ *
+ * Only one \c parallel_for \c runs at a time, the calling thread takes part
+ * in it. Calls from inside a job run serially.
+ */
+class worker_pool {
+  protected:
+    /**
+     * Serializes jobs.
+     */
+    std::mutex m_run_mutex;
+    /**
+     * Guards the job state.
+     */
+    std::mutex m_mutex;
+    /**
+     * Wakes up the workers.
+     */
+    std::condition_variable m_wakeup;
+    /**
+     * Wakes up the caller when workers are done.
+     */
+    std::condition_variable m_done;
+    /**
+     * Current job.
+     */
+    const std::function<void(size_t)>* m_job;
+    /**
+     * Next index to process.
+     */
+    std::atomic<size_t> m_next;
+    /**
+     * Number of indices in the current job.
+     */
+    size_t m_count;
+    /**
+     * Number of workers that are still in the current job.
+     */
+    size_t m_active;
+    /**
+     * Incremented on every job.
+     */
+    uint32_t m_generation;
+    /**
+     * Number of worker threads.
+     */
+    size_t m_workers;
+    /**
+     * Stacks of started workers.
+     */
+    std::vector<stack_range> m_stacks;
+
+    worker_pool()
+        : m_job(nullptr)
+        , m_next(0u)
+        , m_count(0u)
+        , m_active(0u)
+        , m_generation(0u) {
+        auto cores = std::thread::hardware_concurrency();
+        m_workers  = (cores > 1u) ? cores - 1u : 0u;
+
+        // Workers live as long as the process. They are detached to avoid
+        // joining under the loader lock on unload.
+        for (size_t i = 0; i < m_workers; i++)
+            std::thread(&worker_pool::work, this).detach();
+    }
+
+  public:
+    worker_pool(const worker_pool&) = delete;
+    worker_pool(worker_pool&&)      = delete;
+
+    /**
+     * \return The only instance of the pool.
+     */
+    static worker_pool& instance() {
+        // Never destroyed, see the constructor.
+        static worker_pool* pool = new worker_pool();
+        return *pool;
+    }
+
+    /**
+     * Calls \c job \c for every index in [0, count) on all workers and
+     * waits for completion.
+     *
+     * \param count Number of indices.
+     * \param job Function that processes one index.
+     */
+    void parallel_for(const size_t count, const std::function<void(size_t)>& job) {
+        if (!count)
+            return;
+
+        // Nested or pointless parallelism.
+        if (inside_job() || !m_workers || (count == 1u)) {
+            for (size_t i = 0; i < count; i++)
+                job(i);
+            return;
+        }
+
+        std::lock_guard<std::mutex> run_lock(m_run_mutex);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_job    = &job;
+            m_count  = count;
+            m_active = m_workers;
+            m_next.store(0u, std::memory_order_relaxed);
+            m_generation++;
+        }
+        m_wakeup.notify_all();
+
+        inside_job() = true;
+        process();
+        inside_job() = false;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_active == 0u; });
+        m_job = nullptr;
+    }
+
+    /**
+     * \return Number of threads taking part in a job (with the caller).
+     */
+    size_t concurrency() const { return m_workers + 1u; }
+
+    /**
+     * Waits until all workers are started, don't call under the loader
+     * lock.
+     *
+     * \return Stacks of the threads taking part in a job (with the caller).
+     */
+    std::vector<stack_range> stacks() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_stacks.size() == m_workers; });
+
+        auto result = m_stacks;
+        result.push_back(current_thread_stack());
+        return result;
+    }
+
+  private:
+    static bool& inside_job() {
+        thread_local bool inside = false;
+        return inside;
+    }
+
+    void process() {
+        for (;;) {
+            auto index = m_next.fetch_add(1u, std::memory_order_relaxed);
+            if (index >= m_count)
+                break;
+
+            (*m_job)(index);
+        }
+    }
+
+    void work() {
+        inside_job()  = true;
+        uint32_t seen = 0u;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stacks.push_back(current_thread_stack());
+        }
+        m_done.notify_all();
+
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wakeup.wait(lock, [&]() { return m_generation != seen; });
+                seen = m_generation;
+            }
+
+            process();
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (--m_active == 0u)
+                m_done.notify_all();
+        }
+    }
+};   // !class worker_pool
+}   // namespace detail
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_POOL_HPP_
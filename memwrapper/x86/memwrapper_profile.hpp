@@ -0,0 +1,569 @@
+﻿#ifndef MEMWRAPPER_PROFILE_HPP_
+#define MEMWRAPPER_PROFILE_HPP_
+
+namespace memwrapper {
+/**
+ * \brief Creates and installs a hook, the hook is removed when the returned
+ * object is destroyed.
+ */
+using hook_factory_t = std::function<std::shared_ptr<void>()>;
+
+/**
+ * @brief Declarative patch.
+ */
+struct profile_patch {
+    /**
+     * Module (example.dll), absolute address if empty.
+     */
+    std::string module;
+    /**
+     * Offset from the module base or absolute address.
+     */
+    uintptr_t offset;
+    /**
+     * Bytes that will be written.
+     */
+    std::vector<uint8_t> bytes;
+};   // !struct profile_patch
+
+/**
+ * @brief Desired set of patches and hooks.
+ *
+ * Text form, one entry per line. The last entry must be \c end \c, so a
+ * file that is empty or still being written is never taken for a complete
+ * profile:
+ * @code
+ * # comment
+ * patch module.dll 0x1234 90 90 90
+ * patch 0x00401000 EB
+ * hook fps_limiter
+ * end
+ * @endcode
+ */
+struct profile {
+    /**
+     * Patches.
+     */
+    std::vector<profile_patch> patches;
+    /**
+     * Names of registered hooks.
+     */
+    std::vector<std::string> hooks;
+};   // !struct profile
+
+/**
+ * @brief Number of changes made by a profile switch.
+ */
+struct profile_changes {
+    size_t added_patches;
+    size_t removed_patches;
+    size_t added_hooks;
+    size_t removed_hooks;
+};   // !struct profile_changes
+
+namespace detail {
+/**
+ * Splits a line into words.
+ */
+inline std::vector<std::string_view> split_words(std::string_view line) {
+    std::vector<std::string_view> words;
+
+    auto is_space = [&](const size_t at) {
+        return std::isspace(static_cast<uint8_t>(line[at])) != 0;
+    };
+
+    size_t now = 0u;
+    while (now < line.size()) {
+        while ((now < line.size()) && is_space(now))
+            now++;
+
+        auto start = now;
+        while ((now < line.size()) && !is_space(now))
+            now++;
+
+        if (now > start)
+            words.push_back(line.substr(start, now - start));
+    }
+
+    return words;
+}
+
+/**
+ * Parses an unsigned number (decimal or 0x-prefixed hexadecimal).
+ */
+inline bool parse_number(std::string_view word, uintptr_t& value,
+                         const uint32_t base = 0u) {
+    auto radix = base;
+    if (!radix) {
+        radix = 10u;
+        if ((word.size() > 2u) && (word[0] == '0') &&
+            ((word[1] == 'x') || (word[1] == 'X'))) {
+            word.remove_prefix(2u);
+            radix = 16u;
+        }
+    }
+
+    if (word.empty())
+        return false;
+
+    value = 0u;
+    for (auto c : word) {
+        uint32_t digit;
+        if ((c >= '0') && (c <= '9'))
+            digit = c - '0';
+        else if ((c >= 'a') && (c <= 'f'))
+            digit = c - 'a' + 10u;
+        else if ((c >= 'A') && (c <= 'F'))
+            digit = c - 'A' + 10u;
+        else
+            return false;
+
+        if (digit >= radix)
+            return false;
+
+        value = value * radix + digit;
+    }
+
+    return true;
+}
+
+/**
+ * \return Unique key of a patch.
+ */
+inline std::string patch_key(const profile_patch& patch) {
+    constexpr char kHex[] = "0123456789ABCDEF";
+
+    std::string key = patch.module + ':';
+    for (int shift = 28; shift >= 0; shift -= 4)
+        key += kHex[(patch.offset >> shift) & 0xF];
+
+    key += ':';
+    for (auto byte : patch.bytes) {
+        key += kHex[byte >> 4];
+        key += kHex[byte & 0xF];
+    }
+
+    return key;
+}
+}   // namespace detail
+
+/**
+ * Parses the text form of a profile.
+ *
+ * \param text Text of the profile.
+ * \param out Output profile.
+ * \return Is every line valid and is profile terminated with \c end \c.
+ */
+inline bool parse_profile(std::string_view text, profile& out) {
+    out.patches.clear();
+    out.hooks.clear();
+
+    bool terminated = false;
+    while (!text.empty()) {
+        auto end  = text.find('\n');
+        auto line = text.substr(0, end);
+        text.remove_prefix((end == std::string_view::npos) ? text.size()
+                                                           : end + 1u);
+
+        auto comment = line.find('#');
+        if (comment != std::string_view::npos)
+            line = line.substr(0, comment);
+
+        auto words = detail::split_words(line);
+        if (words.empty())
+            continue;
+
+        // Nothing but comments may follow the terminator.
+        if (terminated)
+            return false;
+
+        if ((words[0] == "end") && (words.size() == 1u)) {
+            terminated = true;
+            continue;
+        }
+
+        if ((words[0] == "hook") && (words.size() == 2u)) {
+            out.hooks.emplace_back(words[1]);
+            continue;
+        }
+
+        if ((words[0] != "patch") || (words.size() < 3u))
+            return false;
+
+        // Module is optional.
+        profile_patch patch;
+        size_t        next = 2u;
+
+        if (!detail::parse_number(words[1], patch.offset)) {
+            if (!detail::parse_number(words[2], patch.offset))
+                return false;
+
+            patch.module = std::string(words[1]);
+            next         = 3u;
+        }
+
+        for (; next < words.size(); next++) {
+            uintptr_t byte;
+            auto      word = words[next];
+            if ((word.size() > 2u) && (word[0] == '0') &&
+                ((word[1] == 'x') || (word[1] == 'X')))
+                word.remove_prefix(2u);
+
+            if (!detail::parse_number(word, byte, 16u) || (byte > 0xFFu))
+                return false;
+
+            patch.bytes.push_back(static_cast<uint8_t>(byte));
+        }
+
+        if (patch.bytes.empty())
+            return false;
+
+        out.patches.push_back(std::move(patch));
+    }
+
+    return terminated;
+}
+
+/**
+ * Reads and parses a profile file.
+ *
+ * \param path Path to the file.
+ * \param out Output profile.
+ * \return Was file read and is it a valid terminated profile.
+ */
+inline bool load_profile(std::string_view path, profile& out) {
+    auto file = CreateFile(std::string(path).c_str(), GENERIC_READ,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    std::string text(GetFileSize(file, NULL), '\0');
+
+    DWORD read   = 0;
+    bool  result = text.empty() ||
+                  (ReadFile(file, &text[0], static_cast<DWORD>(text.size()),
+                            &read, NULL) &&
+                   (read == text.size()));
+
+    CloseHandle(file);
+    return result && parse_profile(text, out);
+}
+
+/**
+ * @brief Keeps the process in the state described by a profile.
+ *
+ * Switching a profile touches only the difference: patches and hooks that
+ * are in both profiles stay as they are. All patch writes of a switch go
+ * through one \c write_transaction \c.
+ *
+ * @code{.cpp}
+ * memwrapper::profile_manager manager;
+ * manager.register_hook("fps_limiter", []() {
+ *     auto hook = std::make_shared<memwrapper::memhook<present_t>>(
+ *         present, &on_present);
+ *     hook->install();
+ *     return hook;
+ * });
+ *
+ * manager.load("profiles/debug.txt");
+ * @endcode
+ */
+class profile_manager {
+    struct active_patch {
+        uintptr_t            address;
+        std::vector<uint8_t> original;
+    };
+
+  protected:
+    /**
+     * Registered hook factories.
+     */
+    std::unordered_map<std::string, hook_factory_t> m_factories;
+    /**
+     * Applied patches by key.
+     */
+    std::unordered_map<std::string, active_patch> m_patches;
+    /**
+     * Installed hooks by name.
+     */
+    std::unordered_map<std::string, std::shared_ptr<void>> m_hooks;
+
+  public:
+    profile_manager()                       = default;
+    profile_manager(const profile_manager&) = delete;
+    profile_manager(profile_manager&&)      = delete;
+
+    /**
+     * Destructor. Restores every patch and removes every hook.
+     */
+    ~profile_manager() { apply(profile{}); }
+
+    /**
+     * Registers a hook that profiles can refer to by name.
+     *
+     * \param name Name of the hook.
+     * \param factory Creates and installs the hook.
+     */
+    void register_hook(std::string_view name, hook_factory_t factory) {
+        m_factories[std::string(name)] = std::move(factory);
+    }
+
+    /**
+     * Switches to a profile.
+     *
+     * \param desired New profile.
+     * \return Number of changes.
+     */
+    profile_changes apply(const profile& desired) {
+        profile_changes changes{ 0u, 0u, 0u, 0u };
+
+        std::unordered_map<std::string, const profile_patch*> wanted;
+        for (auto& patch : desired.patches)
+            wanted.emplace(detail::patch_key(patch), &patch);
+
+        auto& registry = detail::ownership_registry::instance();
+
+        write_transaction         transaction;
+        std::vector<active_patch> removed;
+
+        // Removals go first, so additions overwrite them.
+        for (auto it = m_patches.begin(); it != m_patches.end();) {
+            if (wanted.count(it->first)) {
+                ++it;
+                continue;
+            }
+
+            transaction.add(it->second.address, it->second.original);
+            registry.remove(it->second.address, it->second.original.size());
+
+            removed.push_back(std::move(it->second));
+            it = m_patches.erase(it);
+            changes.removed_patches++;
+        }
+
+        for (auto& [key, patch] : wanted) {
+            if (m_patches.count(key))
+                continue;
+
+            uintptr_t address = patch->offset;
+            if (!patch->module.empty()) {
+                auto handle = GetModuleHandle(patch->module.c_str());
+                if (!handle)
+                    continue;
+
+                address += reinterpret_cast<uintptr_t>(handle);
+            }
+
+            active_patch active{ address,
+                                 std::vector<uint8_t>(patch->bytes.size()) };
+            if (detail::read_memory_safe(address, active.original.data(),
+                                         active.original.size()) !=
+                active.original.size())
+                continue;
+
+            // Removed patches are still in memory, their originals are the
+            // true bytes under them.
+            for (auto& old : removed)
+                overlay(active, old);
+
+            transaction.add(address, patch->bytes);
+            registry.add(address, patch->bytes.size());
+
+            m_patches.emplace(key, std::move(active));
+            changes.added_patches++;
+        }
+
+        transaction.commit();
+
+        // Hooks install themselves, only the changed ones are touched.
+        std::vector<std::string> hooks(desired.hooks);
+        std::sort(hooks.begin(), hooks.end());
+
+        for (auto it = m_hooks.begin(); it != m_hooks.end();) {
+            if (std::binary_search(hooks.begin(), hooks.end(), it->first)) {
+                ++it;
+                continue;
+            }
+
+            it = m_hooks.erase(it);
+            changes.removed_hooks++;
+        }
+
+        for (auto& name : hooks) {
+            auto factory = m_factories.find(name);
+            if (m_hooks.count(name) || (factory == m_factories.end()))
+                continue;
+
+            if (auto hook = factory->second()) {
+                m_hooks.emplace(name, std::move(hook));
+                changes.added_hooks++;
+            }
+        }
+
+        return changes;
+    }
+
+    /**
+     * Loads a profile file and switches to it.
+     *
+     * \param path Path to the file.
+     * \param changes Output number of changes (optional).
+     * \return Was profile loaded.
+     */
+    bool load(std::string_view path, profile_changes* changes = nullptr) {
+        profile desired;
+        if (!load_profile(path, desired))
+            return false;
+
+        auto result = apply(desired);
+        if (changes)
+            *changes = result;
+
+        return true;
+    }
+
+    /**
+     * \return Number of applied patches.
+     */
+    size_t patches_count() const { return m_patches.size(); }
+    /**
+     * \return Number of installed hooks.
+     */
+    size_t hooks_count() const { return m_hooks.size(); }
+
+  private:
+    static void overlay(active_patch& to, const active_patch& from) {
+        auto begin = (std::max)(to.address, from.address);
+        auto end   = (std::min)(to.address + to.original.size(),
+                              from.address + from.original.size());
+
+        if (begin < end)
+            std::memcpy(&to.original[begin - to.address],
+                        &from.original[begin - from.address], end - begin);
+    }
+};   // !class profile_manager
+
+/**
+ * @brief Reloads a profile file when it changes. Nothing happens in
+ * background: \c poll() \c is called from the thread that owns the hooks.
+ */
+class profile_watcher {
+  protected:
+    /**
+     * Manager that applies the profile.
+     */
+    profile_manager& m_manager;
+    /**
+     * Path to the profile.
+     */
+    std::string m_path;
+    /**
+     * Change notification of the directory.
+     */
+    HANDLE m_notification;
+    /**
+     * Last seen write time of the file.
+     */
+    FILETIME m_last_write;
+    /**
+     * Last seen size of the file.
+     */
+    uint64_t m_last_size;
+    /**
+     * Has the last reload failed, retried by every poll.
+     */
+    bool m_pending;
+
+  public:
+    profile_watcher(const profile_watcher&) = delete;
+    profile_watcher(profile_watcher&&)      = delete;
+
+    /**
+     * Constructor. Loads the profile and starts watching.
+     *
+     * \param manager Manager that applies the profile.
+     * \param path Path to the profile.
+     */
+    profile_watcher(profile_manager& manager, std::string_view path)
+        : m_manager(manager)
+        , m_path(path)
+        , m_notification(INVALID_HANDLE_VALUE)
+        , m_last_write{ 0, 0 }
+        , m_last_size(0u)
+        , m_pending(false) {
+        auto slash     = m_path.find_last_of("\\/");
+        auto directory = (slash == std::string::npos) ? std::string(".")
+                                                      : m_path.substr(0, slash);
+
+        // Editors that save atomically rename a temporary file over it.
+        m_notification = FindFirstChangeNotification(
+            directory.c_str(), FALSE,
+            FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+
+        reload();
+    }
+
+    /**
+     * Destructor. Stops watching.
+     */
+    ~profile_watcher() {
+        if (m_notification != INVALID_HANDLE_VALUE)
+            FindCloseChangeNotification(m_notification);
+    }
+
+    /**
+     * Reloads the profile if the file was changed or the last reload
+     * failed.
+     *
+     * \return Was profile reloaded.
+     */
+    bool poll() {
+        if (m_notification == INVALID_HANDLE_VALUE)
+            return false;
+
+        if (WaitForSingleObject(m_notification, 0) == WAIT_OBJECT_0)
+            FindNextChangeNotification(m_notification);
+        else if (!m_pending)
+            return false;
+
+        return reload();
+    }
+
+    /**
+     * \return Is directory watched.
+     */
+    bool good() const { return (m_notification != INVALID_HANDLE_VALUE); }
+
+  private:
+    bool reload() {
+        // A file that is being replaced may be missing for a moment.
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        m_pending = true;
+        if (!GetFileAttributesEx(m_path.c_str(), GetFileExInfoStandard, &data))
+            return false;
+
+        auto size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32u) |
+                    data.nFileSizeLow;
+
+        // Other files of the directory may have changed.
+        if (!CompareFileTime(&data.ftLastWriteTime, &m_last_write) &&
+            (size == m_last_size)) {
+            m_pending = false;
+            return false;
+        }
+
+        // Editors write in steps, a file without the terminator is retried
+        // by the next poll.
+        if (!m_manager.load(m_path))
+            return false;
+
+        m_last_write = data.ftLastWriteTime;
+        m_last_size  = size;
+        m_pending    = false;
+        return true;
+    }
+};   // !class profile_watcher
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_PROFILE_HPP_
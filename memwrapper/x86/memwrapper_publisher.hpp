@@ -0,0 +1,452 @@
+﻿#ifndef MEMWRAPPER_PUBLISHER_HPP_
+#define MEMWRAPPER_PUBLISHER_HPP_
+
+namespace memwrapper {
+namespace detail {
+/**
+ * Magic value of the shared state region ('MWSP').
+ */
+constexpr uint32_t kStateMagic = 0x5053574Du;
+/**
+ * Layout version of the shared state region.
+ */
+constexpr uint32_t kStateVersion = 1u;
+/**
+ * How many times a subscriber retries a torn read before giving up.
+ */
+constexpr uint32_t kStateReadRetries = 64u;
+
+/**
+ * Header of the shared state region. Followed by \c entries_count \c
+ * \c state_entry \c structures and the data block.
+ */
+struct state_header {
+    uint32_t magic;
+    uint32_t version;
+    /**
+     * Seqlock counter. Odd while the publisher is writing.
+     */
+    std::atomic<uint32_t> sequence;
+    uint32_t              entries_count;
+    uint32_t              data_size;
+    /**
+     * Number of finished publishes.
+     */
+    uint32_t tick;
+};   // !struct state_header
+
+/**
+ * Location of one published struct inside the data block.
+ */
+struct state_entry {
+    uint32_t offset;
+    uint32_t size;
+};   // !struct state_entry
+
+/**
+ * \return Size of the header with the entries table.
+ */
+inline uint32_t get_state_header_size(const uint32_t entries_count) {
+    return align_value(static_cast<uint32_t>(sizeof(state_header) +
+                                             entries_count * sizeof(state_entry)),
+                       16u);
+}
+}   // namespace detail
+
+/**
+ * @brief Publisher that copies a set of structs into a named shared memory
+ * region on every tick.
+ *
+ * Consumers map the region with \c state_subscriber \c and read consistent
+ * snapshots through a seqlock, so they never touch the target process and
+ * never block the publisher.
+ *
+ * @code{.cpp}
+ * memwrapper::state_publisher publisher;
+ *
+ * void __cdecl frame_hooked() {
+ *  publisher.publish();
+ *  frame_hook->call();
+ * }
+ *
+ * int main() {
+ *  publisher.add(0x00B6F5F0, sizeof(player_t));
+ *  publisher.open("Local\\target_state");
+ *
+ *  frame_hook = std::make_unique<memwrapper::memhook<frame_t>>(0x0053E980,
+ *                                                             frame_hooked);
+ *  frame_hook->install();
+ * }
+ * @endcode
+ */
+class state_publisher {
+    struct source {
+        memory_pointer address;
+        uint32_t       size;
+    };
+
+  protected:
+    /**
+     * Handle of the file mapping.
+     */
+    HANDLE m_mapping;
+    /**
+     * Mapped header of the region.
+     */
+    detail::state_header* m_header;
+    /**
+     * Mapped data block of the region.
+     */
+    uint8_t* m_data;
+    /**
+     * Structs that will be published.
+     */
+    std::vector<source> m_sources;
+    /**
+     * Size of all structs.
+     */
+    uint32_t m_data_size;
+
+  public:
+    state_publisher(const state_publisher&) = delete;
+    state_publisher(state_publisher&&)      = delete;
+
+    state_publisher()
+        : m_mapping(NULL)
+        , m_header(nullptr)
+        , m_data(nullptr)
+        , m_data_size(0u) {}
+
+    /**
+     * Destructor. Unmaps the region.
+     */
+    ~state_publisher() { close(); }
+
+    /**
+     * Adds a struct to the published set. Must be called before \c open \c.
+     *
+     * \param at Address of the struct.
+     * \param size Size of the struct.
+     * \return Index of the entry or -1 if the region is already opened.
+     */
+    int add(const memory_pointer& at, const uint32_t size) {
+        if (good())
+            return -1;
+
+        m_sources.push_back({ at, size });
+        m_data_size += detail::align_value(size, sizeof(uint32_t));
+        return static_cast<int>(m_sources.size() - 1u);
+    }
+
+    /**
+     * Creates the shared memory region.
+     *
+     * \param name Name of the file mapping.
+     * \return Was region created or not.
+     */
+    bool open(std::string_view name) {
+        if (good() || m_sources.empty())
+            return false;
+
+        auto entries_count = static_cast<uint32_t>(m_sources.size());
+        auto header_size   = detail::get_state_header_size(entries_count);
+        auto total_size    = header_size + m_data_size;
+
+        m_mapping = CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                      0, total_size, std::string(name).c_str());
+        if (!m_mapping)
+            return false;
+
+        auto view = reinterpret_cast<uint8_t*>(
+            MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, total_size));
+        if (!view) {
+            CloseHandle(m_mapping);
+            m_mapping = NULL;
+            return false;
+        }
+
+        m_header = reinterpret_cast<detail::state_header*>(view);
+        m_data   = view + header_size;
+
+        // Filling the entries table.
+        auto     entries = reinterpret_cast<detail::state_entry*>(m_header + 1);
+        uint32_t offset  = 0u;
+        for (uint32_t i = 0; i < entries_count; i++) {
+            entries[i] = { offset, m_sources[i].size };
+            offset += detail::align_value(m_sources[i].size, sizeof(uint32_t));
+        }
+
+        m_header->version       = detail::kStateVersion;
+        m_header->entries_count = entries_count;
+        m_header->data_size     = m_data_size;
+        m_header->tick          = 0u;
+        m_header->sequence.store(0u, std::memory_order_relaxed);
+
+        // Publishing the magic last, subscribers check it first.
+        std::atomic_thread_fence(std::memory_order_release);
+        m_header->magic = detail::kStateMagic;
+        return true;
+    }
+
+    /**
+     * Unmaps the region.
+     */
+    void close() {
+        if (!good())
+            return;
+
+        UnmapViewOfFile(m_header);
+        CloseHandle(m_mapping);
+
+        m_header  = nullptr;
+        m_data    = nullptr;
+        m_mapping = NULL;
+    }
+
+    /**
+     * Copies all structs into the region. Intended to be called from a hook
+     * on the frame function of the target.
+     */
+    void publish() {
+        if (!good())
+            return;
+
+        auto sequence = m_header->sequence.load(std::memory_order_relaxed);
+
+        // Odd sequence: subscribers will retry.
+        m_header->sequence.store(sequence + 1u, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        uint8_t* cursor = m_data;
+        for (auto& src : m_sources) {
+            std::memcpy(cursor, src.address, src.size);
+            cursor += detail::align_value(src.size, sizeof(uint32_t));
+        }
+
+        m_header->tick++;
+
+        // Even sequence: snapshot is consistent.
+        m_header->sequence.store(sequence + 2u, std::memory_order_release);
+    }
+
+    /**
+     * \return Is region opened or not.
+     */
+    bool good() const { return (m_header != nullptr); }
+};   // !class state_publisher
+
+/**
+ * @brief Consumer of a region created by \c state_publisher \c. Reading
+ * doesn't issue syscalls or take locks.
+ *
+ * The layout is validated against the size of the mapped view once on
+ * \c open() \c, and every entry again on every read, so a stale or corrupt
+ * publisher can't make the subscriber read past the view.
+ */
+class state_subscriber {
+  protected:
+    /**
+     * Handle of the file mapping.
+     */
+    HANDLE m_mapping;
+    /**
+     * Mapped header of the region.
+     */
+    const detail::state_header* m_header;
+    /**
+     * Mapped entries table of the region.
+     */
+    const detail::state_entry* m_entries;
+    /**
+     * Mapped data block of the region.
+     */
+    const uint8_t* m_data;
+    /**
+     * Number of entries, validated on open.
+     */
+    uint32_t m_entries_count;
+    /**
+     * Size of the data block, validated on open.
+     */
+    uint32_t m_data_size;
+
+  public:
+    state_subscriber(const state_subscriber&) = delete;
+    state_subscriber(state_subscriber&&)      = delete;
+
+    state_subscriber()
+        : m_mapping(NULL)
+        , m_header(nullptr)
+        , m_entries(nullptr)
+        , m_data(nullptr)
+        , m_entries_count(0u)
+        , m_data_size(0u) {}
+
+    /**
+     * Destructor. Unmaps the region.
+     */
+    ~state_subscriber() { close(); }
+
+    /**
+     * Maps a region created by the publisher.
+     *
+     * \param name Name of the file mapping.
+     * \return Was region mapped or not.
+     */
+    bool open(std::string_view name) {
+        if (good())
+            return false;
+
+        m_mapping = OpenFileMapping(FILE_MAP_READ, FALSE,
+                                    std::string(name).c_str());
+        if (!m_mapping)
+            return false;
+
+        auto view = reinterpret_cast<const uint8_t*>(
+            MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        auto header = reinterpret_cast<const detail::state_header*>(view);
+
+        if (!view || !is_valid_view(view)) {
+            if (view)
+                UnmapViewOfFile(view);
+
+            CloseHandle(m_mapping);
+            m_mapping = NULL;
+            return false;
+        }
+
+        using entry_t = detail::state_entry;
+
+        m_header        = header;
+        m_entries       = reinterpret_cast<const entry_t*>(header + 1);
+        m_entries_count = header->entries_count;
+        m_data_size     = header->data_size;
+        m_data          = view + detail::get_state_header_size(m_entries_count);
+        return true;
+    }
+
+    /**
+     * Unmaps the region.
+     */
+    void close() {
+        if (!good())
+            return;
+
+        UnmapViewOfFile(m_header);
+        CloseHandle(m_mapping);
+
+        m_header        = nullptr;
+        m_entries       = nullptr;
+        m_data          = nullptr;
+        m_entries_count = 0u;
+        m_data_size     = 0u;
+        m_mapping       = NULL;
+    }
+
+    /**
+     * Reads a consistent snapshot of one published struct.
+     *
+     * \param index Index returned by \c state_publisher::add \c.
+     * \param out Buffer for the struct.
+     * \param size Size of the buffer.
+     * \return Was snapshot read or not.
+     */
+    bool read(const uint32_t index, void* out, const uint32_t size) const {
+        if (!good() || (index >= m_entries_count))
+            return false;
+
+        // The entry is read from the shared view, it's checked every time.
+        auto entry = m_entries[index];
+        if ((size < entry.size) || (entry.offset > m_data_size) ||
+            (entry.size > m_data_size - entry.offset))
+            return false;
+
+        return read_consistent(
+            [&]() { std::memcpy(out, m_data + entry.offset, entry.size); });
+    }
+
+    /**
+     * Reads a consistent snapshot of one published struct.
+     *
+     * \param index Index returned by \c state_publisher::add \c.
+     * \param out Struct to fill.
+     * \return Was snapshot read or not.
+     */
+    template<typename T>
+    bool read(const uint32_t index, T& out) const {
+        return read(index, &out, sizeof(T));
+    }
+
+    /**
+     * Reads a consistent snapshot of the whole data block.
+     *
+     * \param out Buffer that will hold the data block.
+     * \return Was snapshot read or not.
+     */
+    bool read_all(std::vector<uint8_t>& out) const {
+        if (!good())
+            return false;
+
+        out.resize(m_data_size);
+        return read_consistent(
+            [&]() { std::memcpy(out.data(), m_data, out.size()); });
+    }
+
+    /**
+     * \return Number of finished publishes.
+     */
+    uint32_t get_tick() const { return good() ? m_header->tick : 0u; }
+
+    /**
+     * \return Is region mapped or not.
+     */
+    bool good() const { return (m_header != nullptr); }
+
+  private:
+    static bool is_valid_view(const uint8_t* view) {
+        MEMORY_BASIC_INFORMATION mbi{ 0 };
+        if (!VirtualQuery(view, &mbi, sizeof(mbi)) ||
+            (mbi.RegionSize < sizeof(detail::state_header)))
+            return false;
+
+        auto size   = mbi.RegionSize;
+        auto header = reinterpret_cast<const detail::state_header*>(view);
+        if ((header->magic != detail::kStateMagic) ||
+            (header->version != detail::kStateVersion))
+            return false;
+
+        // The entries table and the data block must fit in the view.
+        auto entries_count = header->entries_count;
+        if (entries_count > (size - sizeof(detail::state_header)) /
+                                sizeof(detail::state_entry))
+            return false;
+
+        auto header_size = detail::get_state_header_size(entries_count);
+        return (header_size <= size) &&
+               (header->data_size <= size - header_size);
+    }
+
+    template<typename Reader>
+    bool read_consistent(Reader&& reader) const {
+        for (uint32_t i = 0; i < detail::kStateReadRetries; i++) {
+            auto begin = m_header->sequence.load(std::memory_order_acquire);
+
+            // Publisher is writing right now.
+            if (begin & 1u) {
+                YieldProcessor();
+                continue;
+            }
+
+            reader();
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_header->sequence.load(std::memory_order_relaxed) == begin)
+                return true;
+        }
+
+        return false;
+    }
+};   // !class state_subscriber
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_PUBLISHER_HPP_
@@ -0,0 +1,527 @@
+﻿#ifndef MEMWRAPPER_REGIONS_HPP_
+#define MEMWRAPPER_REGIONS_HPP_
+
+namespace memwrapper {
+/**
+ * Type of memory behind a region.
+ */
+enum class RegionType : uint32_t {
+    None    = (0),
+    Image   = (1 << 0),
+    Mapped  = (1 << 1),
+    Private = (1 << 2),
+    Any     = (Image | Mapped | Private)
+};
+
+/**
+ * Access rights of a region.
+ */
+enum RegionAccess : uint32_t {
+    kAccessNone    = (0),
+    kAccessRead    = (1 << 0),
+    kAccessWrite   = (1 << 1),
+    kAccessExecute = (1 << 2)
+};
+
+namespace detail {
+/**
+ * Converts a memory flag to memory protection constant.
+ *
+ * \param flag Memory flag.
+ * \return Memory protection constant.
+ */
+inline MemoryProt convert_memory_flag(const uint32_t flag) {
+    switch (flag & 0xFFu) {
+    case PAGE_NOACCESS: return MemoryProt::NoAccess;
+    case PAGE_READONLY: return MemoryProt::ReadOnly;
+    case PAGE_READWRITE: return MemoryProt::ReadWrite;
+    case PAGE_WRITECOPY: return MemoryProt::WriteCopy;
+    case PAGE_EXECUTE: return MemoryProt::Execute;
+    case PAGE_EXECUTE_READ: return MemoryProt::ExecuteRead;
+    case PAGE_EXECUTE_READWRITE: return MemoryProt::ExecuteReadWrite;
+    case PAGE_EXECUTE_WRITECOPY: return MemoryProt::ExecuteWriteCopy;
+
+    default: return MemoryProt::None;
+    }
+}
+
+/**
+ * Converts a memory flag to access rights.
+ *
+ * \param flag Memory flag.
+ * \return Combination of \c RegionAccess \c.
+ */
+inline uint32_t convert_memory_access(const uint32_t flag) {
+    if (flag & PAGE_GUARD)
+        return kAccessNone;
+
+    switch (flag & 0xFFu) {
+    case PAGE_READONLY: return kAccessRead;
+    case PAGE_READWRITE:
+    case PAGE_WRITECOPY: return kAccessRead | kAccessWrite;
+    case PAGE_EXECUTE: return kAccessExecute;
+    case PAGE_EXECUTE_READ: return kAccessRead | kAccessExecute;
+    case PAGE_EXECUTE_READWRITE:
+    case PAGE_EXECUTE_WRITECOPY:
+        return kAccessRead | kAccessWrite | kAccessExecute;
+
+    default: return kAccessNone;
+    }
+}
+
+/**
+ * Converts a memory type to region type.
+ */
+inline RegionType convert_memory_type(const uint32_t type) {
+    switch (type) {
+    case MEM_IMAGE: return RegionType::Image;
+    case MEM_MAPPED: return RegionType::Mapped;
+    case MEM_PRIVATE: return RegionType::Private;
+
+    default: return RegionType::None;
+    }
+}
+}   // namespace detail
+
+/**
+ * @brief Committed region of the address space.
+ */
+struct memory_region {
+    /**
+     * Start of the region.
+     */
+    uintptr_t base;
+    /**
+     * Size of the region.
+     */
+    size_t size;
+    /**
+     * Start of the allocation. For image regions it's the module handle.
+     */
+    uintptr_t allocation_base;
+    /**
+     * Raw memory flag (PAGE_*).
+     */
+    uint32_t flag;
+    /**
+     * Combination of \c RegionAccess \c.
+     */
+    uint32_t access;
+    /**
+     * Type of memory.
+     */
+    RegionType type;
+
+    /**
+     * \return Memory protection constant.
+     */
+    MemoryProt protection() const { return detail::convert_memory_flag(flag); }
+    /**
+     * \return End of the region.
+     */
+    uintptr_t end() const { return base + size; }
+    /**
+     * \return Is address inside the region.
+     */
+    bool contains(const memory_pointer& at) const {
+        return (at.addressof() >= base) && (at.addressof() < end());
+    }
+};   // !struct memory_region
+
+/**
+ * @brief Filter for region enumeration. Default filter accepts every
+ * committed region.
+ */
+struct region_filter {
+    /**
+     * Access rights that region must have (all of them).
+     */
+    uint32_t access = kAccessNone;
+    /**
+     * Accepted types (combination of \c RegionType \c).
+     */
+    uint32_t types = static_cast<uint32_t>(RegionType::Any);
+    /**
+     * Owning module, nullptr for any.
+     */
+    HMODULE module = nullptr;
+
+    /**
+     * \return Is region accepted by the filter.
+     */
+    bool matches(const memory_region& region) const {
+        if ((region.access & access) != access)
+            return false;
+
+        if (!(static_cast<uint32_t>(region.type) & types))
+            return false;
+
+        return !module ||
+               (region.allocation_base == reinterpret_cast<uintptr_t>(module));
+    }
+};   // !struct region_filter
+
+namespace detail {
+/**
+ * Queries the region that contains an address.
+ *
+ * \param at Address.
+ * \param region Output region.
+ * \return End of the queried region or zero if there are no more regions.
+ */
+inline uintptr_t query_region(const uintptr_t at, memory_region& region) {
+    MEMORY_BASIC_INFORMATION mbi{ 0 };
+    if (!VirtualQuery(memory_pointer(at), &mbi, sizeof(mbi)))
+        return 0u;
+
+    region.base            = reinterpret_cast<uintptr_t>(mbi.BaseAddress);
+    region.size            = mbi.RegionSize;
+    region.allocation_base = reinterpret_cast<uintptr_t>(mbi.AllocationBase);
+    region.flag            = (mbi.State == MEM_COMMIT) ? mbi.Protect : 0u;
+    region.access          = convert_memory_access(region.flag);
+    region.type            = (mbi.State == MEM_COMMIT)
+                                 ? convert_memory_type(mbi.Type)
+                                 : RegionType::None;
+
+    auto end = region.base + region.size;
+    return (end > at) ? end : 0u;
+}
+}   // namespace detail
+
+/**
+ * @brief Lazy iterator over committed regions. Every step is one
+ * \c VirtualQuery \c, nothing is stored.
+ */
+class region_iterator {
+  protected:
+    /**
+     * Current region.
+     */
+    memory_region m_region;
+    /**
+     * Where next query starts. Zero if iteration is finished.
+     */
+    uintptr_t m_next;
+    /**
+     * End of the iterated range.
+     */
+    uintptr_t m_end;
+    /**
+     * Filter of the regions.
+     */
+    region_filter m_filter;
+
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = memory_region;
+    using difference_type   = ptrdiff_t;
+    using pointer           = const memory_region*;
+    using reference         = const memory_region&;
+
+    /**
+     * End iterator.
+     */
+    region_iterator()
+        : m_region{}
+        , m_next(0u)
+        , m_end(0u) {}
+
+    /**
+     * \param from Start of the iterated range.
+     * \param to End of the iterated range.
+     * \param filter Filter of the regions.
+     */
+    region_iterator(const uintptr_t from, const uintptr_t to,
+                    const region_filter& filter)
+        : m_region{}
+        , m_next(from)
+        , m_end(to)
+        , m_filter(filter) {
+        advance();
+    }
+
+    reference operator*() const { return m_region; }
+    pointer   operator->() const { return &m_region; }
+
+    region_iterator& operator++() {
+        advance();
+        return *this;
+    }
+
+    region_iterator operator++(int) {
+        auto copy = *this;
+        advance();
+        return copy;
+    }
+
+    bool operator==(const region_iterator& other) const {
+        return (finished() && other.finished()) ||
+               (!finished() && !other.finished() &&
+                (m_region.base == other.m_region.base));
+    }
+
+    bool operator!=(const region_iterator& other) const {
+        return !(*this == other);
+    }
+
+  private:
+    bool finished() const { return (m_region.size == 0u); }
+
+    void advance() {
+        while (m_next && (m_next < m_end)) {
+            auto next = detail::query_region(m_next, m_region);
+            m_next    = next;
+
+            if (next && (m_region.type != RegionType::None) &&
+                m_filter.matches(m_region))
+                return;
+        }
+
+        m_region = memory_region{};
+    }
+};   // !class region_iterator
+
+/**
+ * @brief Range of committed regions for range-for.
+ *
+ * @code{.cpp}
+ * memwrapper::region_filter filter;
+ * filter.access = memwrapper::kAccessExecute;
+ *
+ * for (auto& region : memwrapper::memory_regions(filter))
+ *  std::cout << std::hex << region.base << std::endl;
+ * @endcode
+ */
+class region_range {
+  protected:
+    uintptr_t     m_from;
+    uintptr_t     m_to;
+    region_filter m_filter;
+
+  public:
+    region_range(const uintptr_t from, const uintptr_t to,
+                 const region_filter& filter)
+        : m_from(from)
+        , m_to(to)
+        , m_filter(filter) {}
+
+    region_iterator begin() const { return { m_from, m_to, m_filter }; }
+    region_iterator end() const { return {}; }
+};   // !class region_range
+
+/**
+ * Enumerates committed regions of the process lazily.
+ *
+ * \param filter Filter of the regions.
+ * \return Range for range-for.
+ */
+inline region_range memory_regions(const region_filter& filter = {}) {
+    SYSTEM_INFO sysinfo{ 0 };
+    GetSystemInfo(&sysinfo);
+
+    return { reinterpret_cast<uintptr_t>(sysinfo.lpMinimumApplicationAddress),
+             reinterpret_cast<uintptr_t>(sysinfo.lpMaximumApplicationAddress),
+             filter };
+}
+
+/**
+ * Enumerates committed regions of the memory range lazily.
+ *
+ * \param from Start of the range.
+ * \param size Size of the range.
+ * \param filter Filter of the regions.
+ * \return Range for range-for.
+ */
+inline region_range memory_regions(const memory_pointer& from, const size_t size,
+                                   const region_filter& filter = {}) {
+    return { from.addressof(), from.addressof() + size, filter };
+}
+
+/**
+ * @brief Snapshot of all committed regions.
+ *
+ * The storage is reused between refreshes, so refreshing doesn't allocate
+ * once the address space stopped growing. \c refresh(from, size) \c updates
+ * only a part of the snapshot.
+ */
+class region_map {
+    using storage_t = std::vector<memory_region>;
+
+  protected:
+    /**
+     * Sorted committed regions.
+     */
+    storage_t m_regions;
+    /**
+     * Temporary storage for partial refreshes.
+     */
+    storage_t m_scratch;
+    /**
+     * Is snapshot outdated.
+     */
+    bool m_dirty;
+
+  public:
+    /**
+     * @brief Filtered view of the snapshot.
+     */
+    class view {
+      public:
+        class iterator {
+            storage_t::const_iterator m_now;
+            storage_t::const_iterator m_end;
+            const region_filter*      m_filter;
+
+          public:
+            iterator(storage_t::const_iterator now,
+                     storage_t::const_iterator end,
+                     const region_filter*      filter)
+                : m_now(now)
+                , m_end(end)
+                , m_filter(filter) {
+                skip();
+            }
+
+            const memory_region& operator*() const { return *m_now; }
+            const memory_region* operator->() const { return &*m_now; }
+
+            iterator& operator++() {
+                ++m_now;
+                skip();
+                return *this;
+            }
+
+            bool operator!=(const iterator& other) const {
+                return m_now != other.m_now;
+            }
+
+          private:
+            void skip() {
+                while ((m_now != m_end) && !m_filter->matches(*m_now))
+                    ++m_now;
+            }
+        };   // !class iterator
+
+        view(const storage_t& regions, const region_filter& filter)
+            : m_regions(regions)
+            , m_filter(filter) {}
+
+        iterator begin() const {
+            return { m_regions.begin(), m_regions.end(), &m_filter };
+        }
+        iterator end() const {
+            return { m_regions.end(), m_regions.end(), &m_filter };
+        }
+
+      private:
+        const storage_t& m_regions;
+        region_filter    m_filter;
+    };   // !class view
+
+    region_map()
+        : m_dirty(true) {}
+
+    /**
+     * Rebuilds the whole snapshot.
+     */
+    void refresh() {
+        m_regions.clear();
+        for (auto& region : memory_regions())
+            m_regions.push_back(region);
+
+        m_dirty = false;
+    }
+
+    /**
+     * Rebuilds a part of the snapshot.
+     *
+     * \param from Start of the changed range.
+     * \param size Size of the changed range.
+     */
+    void refresh(const memory_pointer& from, const size_t size) {
+        if (m_dirty)
+            return refresh();
+
+        auto begin = from.addressof();
+        auto end   = begin + size;
+
+        // Widening the range to the regions that it touches.
+        auto first = std::upper_bound(m_regions.begin(), m_regions.end(), begin,
+                                      [](const uintptr_t at,
+                                         const memory_region& region) {
+                                          return at < region.end();
+                                      });
+        auto last  = std::lower_bound(first, m_regions.end(), end,
+                                      [](const memory_region& region,
+                                         const uintptr_t      at) {
+                                          return region.base < at;
+                                      });
+
+        if (first != m_regions.end())
+            begin = (std::min)(begin, first->base);
+        if (last != first)
+            end = (std::max)(end, std::prev(last)->end());
+
+        m_scratch.clear();
+        for (auto& region : memory_regions(begin, end - begin))
+            m_scratch.push_back(region);
+
+        // Fresh regions may have grown over the following ones.
+        while (!m_scratch.empty() && (last != m_regions.end()) &&
+               (last->base < m_scratch.back().end()))
+            ++last;
+
+        auto at = m_regions.erase(first, last);
+        m_regions.insert(at, m_scratch.begin(), m_scratch.end());
+    }
+
+    /**
+     * Marks the snapshot as outdated. It will be rebuilt on next access.
+     */
+    void invalidate() { m_dirty = true; }
+
+    /**
+     * Finds the region that contains an address.
+     *
+     * \param at Address.
+     * \return Region or nullptr.
+     */
+    const memory_region* find(const memory_pointer& at) {
+        ensure();
+
+        auto it = std::upper_bound(m_regions.begin(), m_regions.end(),
+                                   at.addressof(),
+                                   [](const uintptr_t      address,
+                                      const memory_region& region) {
+                                       return address < region.end();
+                                   });
+
+        return ((it != m_regions.end()) && it->contains(at)) ? &*it : nullptr;
+    }
+
+    /**
+     * \param filter Filter of the regions.
+     * \return Filtered view for range-for.
+     */
+    view select(const region_filter& filter = {}) {
+        ensure();
+        return { m_regions, filter };
+    }
+
+    /**
+     * \return All regions of the snapshot.
+     */
+    const storage_t& regions() {
+        ensure();
+        return m_regions;
+    }
+
+  private:
+    void ensure() {
+        if (m_dirty)
+            refresh();
+    }
+};   // !class region_map
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_REGIONS_HPP_
@@ -0,0 +1,398 @@
+﻿#ifndef MEMWRAPPER_SCAN_HPP_
+#define MEMWRAPPER_SCAN_HPP_
+
+namespace memwrapper {
+/**
+ * \brief Size of one chunk of a parallel scan.
+ */
+constexpr uint32_t kScanChunkSize = 0x40000u;
+
+/**
+ * @brief Set of patterns that are searched in one pass.
+ *
+ * Every pattern is anchored on one of its required bytes. Up to
+ * \c kMaxSimdAnchors \c distinct anchors are located with SSE2, larger sets
+ * use a byte lookup table. Candidates are verified against the whole
+ * pattern.
+ */
+class pattern_set {
+  public:
+    /**
+     * \brief Anchors located with SSE2.
+     */
+    static constexpr size_t kMaxSimdAnchors = 4u;
+
+  protected:
+    struct compiled_pattern {
+        std::vector<uint8_t> bytes;
+        std::vector<uint8_t> required;
+        uint32_t             anchor;
+    };
+
+    /**
+     * All patterns.
+     */
+    std::vector<compiled_pattern> m_patterns;
+    /**
+     * Patterns by anchor byte.
+     */
+    std::vector<uint32_t> m_buckets[256];
+    /**
+     * Distinct anchor bytes.
+     */
+    std::vector<uint8_t> m_anchors;
+    /**
+     * Length of the longest pattern.
+     */
+    uint32_t m_max_length;
+
+  public:
+    pattern_set()
+        : m_max_length(0u) {}
+
+    /**
+     * Adds a pattern.
+     *
+     * \param pattern The pattern to search for.
+     * \param mask The mask of the pattern ('x' - required byte, '?' -
+     * optional byte).
+     * \return Index of the pattern or -1 if pattern has no required bytes.
+     */
+    int add(std::string_view pattern, std::string_view mask) {
+        auto size = (std::min)(pattern.size(), mask.size());
+
+        compiled_pattern entry;
+        entry.bytes.assign(pattern.begin(), pattern.begin() + size);
+        entry.required.resize(size);
+        for (size_t i = 0; i < size; i++)
+            entry.required[i] = (mask[i] != '?');
+
+        // Choosing an anchor that is rare in code.
+        auto anchor = static_cast<uint32_t>(size);
+        for (uint32_t i = 0; i < size; i++) {
+            if (!entry.required[i])
+                continue;
+
+            if (anchor == size)
+                anchor = i;
+
+            auto byte = entry.bytes[i];
+            if ((byte != 0x00) && (byte != 0xFF) && (byte != 0xCC) &&
+                (byte != 0x90) && (byte != 0x8B)) {
+                anchor = i;
+                break;
+            }
+        }
+
+        if (anchor == size)
+            return -1;
+
+        entry.anchor = anchor;
+        auto index   = static_cast<uint32_t>(m_patterns.size());
+        auto byte    = entry.bytes[anchor];
+
+        if (m_buckets[byte].empty())
+            m_anchors.push_back(byte);
+
+        m_buckets[byte].push_back(index);
+        m_max_length = (std::max)(m_max_length, static_cast<uint32_t>(size));
+        m_patterns.push_back(std::move(entry));
+        return static_cast<int>(index);
+    }
+
+    /**
+     * Scans a readable memory block.
+     *
+     * \param begin Start of the block.
+     * \param end End of the block.
+     * \param found Called with pattern index and address of every match.
+     */
+    template<typename Callback>
+    void scan(const uint8_t* begin, const uint8_t* end, Callback&& found) const {
+        if (m_patterns.empty() || (begin >= end))
+            return;
+
+        if (m_anchors.size() <= kMaxSimdAnchors)
+            scan_simd(begin, end, found);
+        else
+            scan_table(begin, end, found);
+    }
+
+    /**
+     * \return Number of patterns.
+     */
+    size_t size() const { return m_patterns.size(); }
+    /**
+     * \return Length of the longest pattern.
+     */
+    uint32_t max_length() const { return m_max_length; }
+
+  private:
+    template<typename Callback>
+    void check(const uint8_t* begin, const uint8_t* end, const uint8_t* at,
+               Callback& found) const {
+        for (auto index : m_buckets[*at]) {
+            auto& pattern = m_patterns[index];
+            auto  start   = at - pattern.anchor;
+
+            if ((start < begin) || (start + pattern.bytes.size() > end))
+                continue;
+
+            size_t i = 0;
+            for (; i < pattern.bytes.size(); i++) {
+                if (pattern.required[i] && (start[i] != pattern.bytes[i]))
+                    break;
+            }
+
+            if (i == pattern.bytes.size())
+                found(index, reinterpret_cast<uintptr_t>(start));
+        }
+    }
+
+    template<typename Callback>
+    void scan_simd(const uint8_t* begin, const uint8_t* end,
+                   Callback& found) const {
+        __m128i anchors[kMaxSimdAnchors];
+        for (size_t i = 0; i < m_anchors.size(); i++)
+            anchors[i] = _mm_set1_epi8(static_cast<char>(m_anchors[i]));
+
+        auto now = begin;
+        for (; now + sizeof(__m128i) <= end; now += sizeof(__m128i)) {
+            auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(now));
+            auto hits  = _mm_cmpeq_epi8(block, anchors[0]);
+            for (size_t i = 1; i < m_anchors.size(); i++)
+                hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, anchors[i]));
+
+            auto bits = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+            for (uint32_t k = 0; bits; k++, bits >>= 1) {
+                if (bits & 1u)
+                    check(begin, end, now + k, found);
+            }
+        }
+
+        for (; now < end; now++) {
+            if (!m_buckets[*now].empty())
+                check(begin, end, now, found);
+        }
+    }
+
+    template<typename Callback>
+    void scan_table(const uint8_t* begin, const uint8_t* end,
+                    Callback& found) const {
+        for (auto now = begin; now < end; now++) {
+            if (!m_buckets[*now].empty())
+                check(begin, end, now, found);
+        }
+    }
+};   // !class pattern_set
+
+/**
+ * @brief Loaded module.
+ */
+struct module_info {
+    /**
+     * File name of the module (example.dll).
+     */
+    std::string name;
+    /**
+     * Base address of the module.
+     */
+    uintptr_t base;
+    /**
+     * Size of the image.
+     */
+    uint32_t size;
+};   // !struct module_info
+
+/**
+ * @brief Matches of a pattern set in one module.
+ */
+struct module_scan_result {
+    /**
+     * The scanned module.
+     */
+    module_info module;
+    /**
+     * Lowest match of each pattern, zero if not found.
+     */
+    std::vector<uintptr_t> matches;
+};   // !struct module_scan_result
+
+namespace detail {
+/**
+ * Compares file names case-insensitively.
+ */
+inline bool equal_module_names(std::string_view a, std::string_view b) {
+    if (a.size() != b.size())
+        return false;
+
+    for (size_t i = 0; i < a.size(); i++) {
+        if (std::tolower(static_cast<uint8_t>(a[i])) !=
+            std::tolower(static_cast<uint8_t>(b[i])))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Builds the description of a loaded module.
+ *
+ * \param handle Base address of the module.
+ * \param info Output description.
+ * \return Is it a valid module.
+ */
+inline bool get_module_info(const HMODULE handle, module_info& info) {
+    image_view image(handle);
+    if (!image.good())
+        return false;
+
+    char path[MAX_PATH]{ 0 };
+    if (!GetModuleFileName(handle, path, MAX_PATH))
+        return false;
+
+    std::string_view full(path);
+    auto             slash = full.find_last_of("\\/");
+
+    info.name = std::string(
+        (slash == std::string_view::npos) ? full : full.substr(slash + 1u));
+    info.base = reinterpret_cast<uintptr_t>(handle);
+    info.size = image.image_size();
+    return true;
+}
+}   // namespace detail
+
+/**
+ * Enumerates loaded modules by walking image regions.
+ *
+ * \return Loaded modules sorted by base address.
+ */
+inline std::vector<module_info> loaded_modules() {
+    std::vector<module_info> result;
+
+    region_filter filter;
+    filter.access = kAccessRead;
+    filter.types  = static_cast<uint32_t>(RegionType::Image);
+
+    module_info info;
+    for (auto& region : memory_regions(filter)) {
+        // The first region of every image holds its headers.
+        if (region.base != region.allocation_base)
+            continue;
+
+        if (detail::get_module_info(
+                reinterpret_cast<HMODULE>(region.allocation_base), info))
+            result.push_back(info);
+    }
+
+    return result;
+}
+
+/**
+ * Searches a pattern set in many modules with one parallel sweep.
+ *
+ * \param patterns Patterns to search for.
+ * \param modules Modules to scan.
+ * \return Lowest match of every pattern in every module.
+ */
+inline std::vector<module_scan_result>
+scan_modules(const pattern_set&              patterns,
+             const std::vector<module_info>& modules) {
+    struct chunk {
+        uint32_t  module;
+        uintptr_t begin;
+        uintptr_t end;
+    };
+
+    std::vector<module_scan_result> result(modules.size());
+    std::vector<chunk>              chunks;
+
+    for (uint32_t i = 0; i < modules.size(); i++) {
+        result[i].module = modules[i];
+        result[i].matches.resize(patterns.size(), 0u);
+
+        region_filter filter;
+        filter.access = kAccessRead;
+        filter.types  = static_cast<uint32_t>(RegionType::Image);
+        filter.module = reinterpret_cast<HMODULE>(modules[i].base);
+
+        // Joining adjacent readable regions into spans.
+        std::vector<std::pair<uintptr_t, uintptr_t>> spans;
+        for (auto& region : memory_regions(modules[i].base, modules[i].size,
+                                           filter)) {
+            if (!spans.empty() && (spans.back().second == region.base))
+                spans.back().second = region.end();
+            else
+                spans.push_back({ region.base, region.end() });
+        }
+
+        // Splitting spans into overlapping chunks.
+        auto overlap = patterns.max_length();
+        for (auto& span : spans) {
+            for (auto now = span.first; now < span.second; now += kScanChunkSize)
+                chunks.push_back(
+                    { i, now,
+                      (std::min)(span.second, now + kScanChunkSize + overlap) });
+        }
+    }
+
+    // Lowest match of every pattern in every module.
+    std::vector<std::atomic<uintptr_t>> lowest(modules.size() * patterns.size());
+    for (auto& value : lowest)
+        value.store(0u, std::memory_order_relaxed);
+
+    detail::worker_pool::instance().parallel_for(
+        chunks.size(), [&](const size_t index) {
+            auto& now  = chunks[index];
+            auto  base = now.module * patterns.size();
+
+            patterns.scan(reinterpret_cast<const uint8_t*>(now.begin),
+                          reinterpret_cast<const uint8_t*>(now.end),
+                          [&](const uint32_t pattern, const uintptr_t at) {
+                              auto& slot    = lowest[base + pattern];
+                              auto  current = slot.load(std::memory_order_relaxed);
+
+                              while ((!current || (at < current)) &&
+                                     !slot.compare_exchange_weak(current, at))
+                                  ;
+                          });
+        });
+
+    for (uint32_t i = 0; i < modules.size(); i++) {
+        for (uint32_t k = 0; k < patterns.size(); k++)
+            result[i].matches[k] = lowest[i * patterns.size() + k].load();
+    }
+
+    return result;
+}
+
+/**
+ * Searches a pattern set in all loaded modules or in the named ones.
+ *
+ * \param patterns Patterns to search for.
+ * \param names Modules to scan (example.dll, process.exe), all if empty.
+ * \return Lowest match of every pattern in every module.
+ */
+inline std::vector<module_scan_result>
+search_modules_patterns(const pattern_set&                   patterns,
+                        const std::vector<std::string_view>& names = {}) {
+    auto modules = loaded_modules();
+
+    if (!names.empty()) {
+        modules.erase(std::remove_if(modules.begin(), modules.end(),
+                                     [&](const module_info& info) {
+                                         for (auto name : names) {
+                                             if (detail::equal_module_names(
+                                                     info.name, name))
+                                                 return false;
+                                         }
+                                         return true;
+                                     }),
+                      modules.end());
+    }
+
+    return scan_modules(patterns, modules);
+}
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_SCAN_HPP_
@@ -0,0 +1,531 @@
+﻿#ifndef MEMWRAPPER_SNAPSHOT_HPP_
+#define MEMWRAPPER_SNAPSHOT_HPP_
+
+namespace memwrapper {
+/**
+ * \brief Size of one storage chunk of the snapshot store.
+ */
+constexpr uint32_t kSnapshotChunkSize = 0x400000u;
+/**
+ * \brief Identifier of a zero page in a snapshot.
+ */
+constexpr uint32_t kZeroPage = 0xFFFFFFFFu;
+
+namespace detail {
+/**
+ * Minimal length of a match of the LZ codec.
+ */
+constexpr uint32_t kLzMinMatch = 4u;
+/**
+ * Number of bits in the hash of the LZ codec.
+ */
+constexpr uint32_t kLzHashBits = 12u;
+
+/**
+ * Writes an LZ length extension (255, 255, ..., rest).
+ */
+inline uint8_t* lz_write_length(uint8_t* out, const uint8_t* out_end,
+                                uint32_t length) {
+    while (length >= 255u) {
+        if (out >= out_end)
+            return nullptr;
+
+        *out++ = 255u;
+        length -= 255u;
+    }
+
+    if (out >= out_end)
+        return nullptr;
+
+    *out++ = static_cast<uint8_t>(length);
+    return out;
+}
+
+/**
+ * Compresses a block with a byte-oriented LZ77 codec (LZ4-style sequences
+ * of literals and matches, 16-bit offsets).
+ *
+ * \param src Source block (up to 64 Kb).
+ * \param size Size of the source block.
+ * \param out Output buffer.
+ * \param capacity Size of the output buffer.
+ * \return Compressed size or zero if it doesn't fit into \c capacity \c.
+ */
+inline uint32_t lz_compress(const uint8_t* src, const uint32_t size,
+                            uint8_t* out, const uint32_t capacity) {
+    uint16_t table[1u << kLzHashBits];
+    std::memset(table, 0xFF, sizeof(table));
+
+    auto hash = [](const uint8_t* at) {
+        uint32_t value;
+        std::memcpy(&value, at, sizeof(value));
+        return (value * 2654435761u) >> (32u - kLzHashBits);
+    };
+
+    auto out_begin = out;
+    auto out_end   = out + capacity;
+
+    // Sequence: token, literals length, literals, offset, match length.
+    auto emit = [&](const uint8_t* literals, uint32_t literals_length,
+                    uint32_t offset, uint32_t match_length) -> bool {
+        if (out >= out_end)
+            return false;
+
+        auto token = out++;
+        auto match = match_length ? match_length - kLzMinMatch : 0u;
+
+        *token = static_cast<uint8_t>(((std::min)(literals_length, 15u) << 4) |
+                                      (std::min)(match, 15u));
+
+        if ((literals_length >= 15u) &&
+            !(out = lz_write_length(out, out_end, literals_length - 15u)))
+            return false;
+
+        if (out + literals_length > out_end)
+            return false;
+
+        std::memcpy(out, literals, literals_length);
+        out += literals_length;
+
+        if (!match_length)
+            return true;
+
+        if (out + sizeof(uint16_t) > out_end)
+            return false;
+
+        *out++ = static_cast<uint8_t>(offset);
+        *out++ = static_cast<uint8_t>(offset >> 8);
+
+        return (match < 15u) ||
+               (out = lz_write_length(out, out_end, match - 15u)) != nullptr;
+    };
+
+    uint32_t anchor = 0u;
+    uint32_t now    = 0u;
+
+    while (now + kLzMinMatch <= size) {
+        auto  key       = hash(src + now);
+        auto  candidate = table[key];
+        table[key]      = static_cast<uint16_t>(now);
+
+        if ((candidate == 0xFFFFu) ||
+            std::memcmp(src + candidate, src + now, kLzMinMatch)) {
+            now++;
+            continue;
+        }
+
+        auto length = kLzMinMatch;
+        while ((now + length < size) &&
+               (src[candidate + length] == src[now + length]))
+            length++;
+
+        if (!emit(src + anchor, now - anchor, now - candidate, length))
+            return 0u;
+
+        now += length;
+        anchor = now;
+    }
+
+    // Trailing literals without a match.
+    if (!emit(src + anchor, size - anchor, 0u, 0u))
+        return 0u;
+
+    return static_cast<uint32_t>(out - out_begin);
+}
+
+/**
+ * Decompresses a block made by \c lz_compress \c.
+ *
+ * \param src Compressed block.
+ * \param size Size of the compressed block.
+ * \param out Output buffer.
+ * \param capacity Expected size of the output.
+ * \return Was block decompressed into exactly \c capacity \c bytes.
+ */
+inline bool lz_decompress(const uint8_t* src, const uint32_t size, uint8_t* out,
+                          const uint32_t capacity) {
+    auto src_end = src + size;
+    auto dst     = out;
+    auto dst_end = out + capacity;
+
+    auto read_length = [&](uint32_t length) -> uint32_t {
+        uint8_t byte = 255u;
+        while ((byte == 255u) && (src < src_end)) {
+            byte = *src++;
+            length += byte;
+        }
+        return length;
+    };
+
+    while (src < src_end) {
+        auto token   = *src++;
+        auto literal = static_cast<uint32_t>(token >> 4);
+        if (literal == 15u)
+            literal = read_length(literal);
+
+        if ((src + literal > src_end) || (dst + literal > dst_end))
+            return false;
+
+        std::memcpy(dst, src, literal);
+        src += literal;
+        dst += literal;
+
+        // The last sequence has no match.
+        if (src >= src_end)
+            break;
+
+        if (src + sizeof(uint16_t) > src_end)
+            return false;
+
+        uint32_t offset = src[0] | (src[1] << 8);
+        src += sizeof(uint16_t);
+
+        auto match = static_cast<uint32_t>(token & 0x0F);
+        if (match == 15u)
+            match = read_length(match);
+        match += kLzMinMatch;
+
+        if (!offset || (dst - out < static_cast<ptrdiff_t>(offset)) ||
+            (dst + match > dst_end))
+            return false;
+
+        // Overlapping copy.
+        auto from = dst - offset;
+        for (uint32_t i = 0; i < match; i++)
+            dst[i] = from[i];
+        dst += match;
+    }
+
+    return (dst == dst_end);
+}
+
+/**
+ * \return 64-bit hash of a page.
+ */
+inline uint64_t hash_page(const uint8_t* page) {
+    uint64_t hash = 0x9E3779B97F4A7C15ull;
+    for (uint32_t i = 0; i < kPageSize4Kb; i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, page + i, sizeof(word));
+
+        hash ^= word;
+        hash *= 0xFF51AFD7ED558CCDull;
+        hash ^= hash >> 32;
+    }
+
+    return hash;
+}
+
+/**
+ * \return Is every byte of a page zero.
+ */
+inline bool is_zero_page(const uint8_t* page) {
+    auto acc = _mm_setzero_si128();
+    for (uint32_t i = 0; i < kPageSize4Kb; i += sizeof(__m128i))
+        acc = _mm_or_si128(acc, _mm_loadu_si128(
+                                    reinterpret_cast<const __m128i*>(page + i)));
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) ==
+           0xFFFF;
+}
+}   // namespace detail
+
+/**
+ * @brief Store of address space snapshots with page granularity.
+ *
+ * Equal pages are stored once (deduplicated by hash), zero pages aren't
+ * stored at all, other pages are compressed one by one, so any page of any
+ * snapshot is decompressed on its own in microseconds.
+ *
+ * @code{.cpp}
+ * memwrapper::snapshot_store store;
+ * auto before = store.capture(heap, heap_size);
+ * // ...
+ * auto after = store.capture(heap, heap_size);
+ *
+ * uint8_t page[memwrapper::kPageSize4Kb];
+ * store.read_page(before, heap, page);
+ * @endcode
+ */
+class snapshot_store {
+    struct stored_page {
+        uint32_t chunk;
+        uint32_t offset;
+        uint16_t size;
+        /**
+         * Stored without compression.
+         */
+        bool raw;
+    };
+
+    struct snapshot {
+        std::vector<uintptr_t> addresses;
+        std::vector<uint32_t>  pages;
+    };
+
+  protected:
+    /**
+     * Storage chunks with page data.
+     */
+    std::vector<bulk_buffer> m_chunks;
+    /**
+     * Used bytes of the last chunk.
+     */
+    uint32_t m_chunk_used;
+    /**
+     * Unique stored pages.
+     */
+    std::vector<stored_page> m_pages;
+    /**
+     * Unique pages by hash.
+     */
+    std::unordered_multimap<uint64_t, uint32_t> m_index;
+    /**
+     * All snapshots.
+     */
+    std::vector<snapshot> m_snapshots;
+    /**
+     * Number of captured pages (including zero and duplicated ones).
+     */
+    size_t m_captured_pages;
+    /**
+     * Number of captured zero pages.
+     */
+    size_t m_zero_pages;
+
+  public:
+    snapshot_store(const snapshot_store&) = delete;
+    snapshot_store(snapshot_store&&)      = delete;
+
+    snapshot_store()
+        : m_chunk_used(kSnapshotChunkSize)
+        , m_captured_pages(0u)
+        , m_zero_pages(0u) {}
+
+    /**
+     * Captures every readable committed page of a memory range, the range
+     * is widened to whole pages.
+     *
+     * \param from Start of the range.
+     * \param size Size of the range.
+     * \param filter Filter of the regions.
+     * \return Index of the snapshot.
+     */
+    uint32_t capture(const memory_pointer& from, const size_t size,
+                     region_filter filter = {}) {
+        filter.access |= kAccessRead;
+
+        snapshot shot;
+        auto     begin = from.addressof() & ~(kPageSize4Kb - 1u);
+        auto     end   = (from.addressof() + size + kPageSize4Kb - 1u) &
+                     ~(kPageSize4Kb - 1u);
+
+        for (auto& region : memory_regions(begin, end - begin, filter))
+            capture_region((std::max)(region.base, begin),
+                           (std::min)(region.end(), end), shot);
+
+        m_snapshots.push_back(std::move(shot));
+        return static_cast<uint32_t>(m_snapshots.size() - 1u);
+    }
+
+    /**
+     * Captures every readable committed page of the process.
+     *
+     * \param filter Filter of the regions.
+     * \return Index of the snapshot.
+     */
+    uint32_t capture(region_filter filter = {}) {
+        filter.access |= kAccessRead;
+
+        snapshot shot;
+        for (auto& region : memory_regions(filter))
+            capture_region(region.base, region.end(), shot);
+
+        m_snapshots.push_back(std::move(shot));
+        return static_cast<uint32_t>(m_snapshots.size() - 1u);
+    }
+
+    /**
+     * Reads one page of a snapshot.
+     *
+     * \param index Index of the snapshot.
+     * \param at Address inside the page.
+     * \param out Buffer of \c kPageSize4Kb \c bytes.
+     * \return Is page in the snapshot.
+     */
+    bool read_page(const uint32_t index, const memory_pointer& at,
+                   uint8_t* out) const {
+        if (index >= m_snapshots.size())
+            return false;
+
+        auto& shot = m_snapshots[index];
+        auto  page = at.addressof() & ~(kPageSize4Kb - 1u);
+        auto  it   = std::lower_bound(shot.addresses.begin(),
+                                      shot.addresses.end(), page);
+
+        if ((it == shot.addresses.end()) || (*it != page))
+            return false;
+
+        return decode(shot.pages[it - shot.addresses.begin()], out);
+    }
+
+    /**
+     * Reads bytes of a snapshot.
+     *
+     * \param index Index of the snapshot.
+     * \param at Start of the bytes.
+     * \param out Output buffer.
+     * \param size Number of bytes.
+     * \return Are all bytes in the snapshot.
+     */
+    bool read(const uint32_t index, const memory_pointer& at, void* out,
+              const size_t size) const {
+        uint8_t page[kPageSize4Kb];
+        auto    dst = reinterpret_cast<uint8_t*>(out);
+        auto    now = at.addressof();
+        auto    end = now + size;
+
+        while (now < end) {
+            if (!read_page(index, now, page))
+                return false;
+
+            auto offset = now & (kPageSize4Kb - 1u);
+            auto length = (std::min)(end - now, kPageSize4Kb - offset);
+
+            std::memcpy(dst, page + offset, length);
+            dst += length;
+            now += length;
+        }
+
+        return true;
+    }
+
+    /**
+     * \param index Index of the snapshot.
+     * \return Sorted addresses of all pages in the snapshot.
+     */
+    const std::vector<uintptr_t>& pages(const uint32_t index) const {
+        return m_snapshots.at(index).addresses;
+    }
+
+    /**
+     * \return Number of snapshots.
+     */
+    size_t size() const { return m_snapshots.size(); }
+    /**
+     * \return Number of captured pages (including zero and duplicated ones).
+     */
+    size_t captured_pages() const { return m_captured_pages; }
+    /**
+     * \return Number of captured zero pages.
+     */
+    size_t zero_pages() const { return m_zero_pages; }
+    /**
+     * \return Number of stored unique pages.
+     */
+    size_t unique_pages() const { return m_pages.size(); }
+
+    /**
+     * \return Number of bytes used for page data.
+     */
+    size_t stored_bytes() const {
+        return m_chunks.empty() ? 0u
+                                : (m_chunks.size() - 1u) * kSnapshotChunkSize +
+                                      m_chunk_used;
+    }
+
+    /**
+     * Drops all snapshots and pages.
+     */
+    void clear() {
+        m_chunks.clear();
+        m_pages.clear();
+        m_index.clear();
+        m_snapshots.clear();
+
+        m_chunk_used     = kSnapshotChunkSize;
+        m_captured_pages = 0u;
+        m_zero_pages     = 0u;
+    }
+
+  private:
+    void capture_region(const uintptr_t begin, const uintptr_t end,
+                        snapshot& shot) {
+        // Reading in batches to save syscalls.
+        constexpr uint32_t kBatch = 16u * kPageSize4Kb;
+        std::unique_ptr<uint8_t[]> batch = std::make_unique<uint8_t[]>(kBatch);
+
+        for (auto now = begin; now < end; now += kBatch) {
+            auto length = (std::min)(end - now, static_cast<uintptr_t>(kBatch));
+            detail::read_memory_safe(now, batch.get(), length);
+
+            for (uint32_t offset = 0; offset < length; offset += kPageSize4Kb) {
+                shot.addresses.push_back(now + offset);
+                shot.pages.push_back(store(batch.get() + offset));
+            }
+        }
+    }
+
+    uint32_t store(const uint8_t* page) {
+        m_captured_pages++;
+
+        if (detail::is_zero_page(page)) {
+            m_zero_pages++;
+            return kZeroPage;
+        }
+
+        uint8_t existing[kPageSize4Kb];
+        auto    hash  = detail::hash_page(page);
+        auto    range = m_index.equal_range(hash);
+
+        for (auto it = range.first; it != range.second; ++it) {
+            if (decode(it->second, existing) &&
+                !std::memcmp(existing, page, kPageSize4Kb))
+                return it->second;
+        }
+
+        // Compressing, storing raw if it doesn't pay off.
+        uint8_t compressed[kPageSize4Kb];
+        auto    size = detail::lz_compress(page, kPageSize4Kb, compressed,
+                                           kPageSize4Kb - 1u);
+        auto    raw  = (size == 0u);
+        if (raw)
+            size = kPageSize4Kb;
+
+        if (m_chunk_used + size > kSnapshotChunkSize) {
+            m_chunks.emplace_back(kSnapshotChunkSize);
+            m_chunk_used = 0u;
+        }
+
+        std::memcpy(&m_chunks.back()[m_chunk_used], raw ? page : compressed,
+                    size);
+
+        auto index = static_cast<uint32_t>(m_pages.size());
+        m_pages.push_back({ static_cast<uint32_t>(m_chunks.size() - 1u),
+                            m_chunk_used, static_cast<uint16_t>(size), raw });
+        m_index.emplace(hash, index);
+
+        m_chunk_used += size;
+        return index;
+    }
+
+    bool decode(const uint32_t index, uint8_t* out) const {
+        if (index == kZeroPage) {
+            std::memset(out, 0, kPageSize4Kb);
+            return true;
+        }
+
+        auto& page = m_pages[index];
+        auto  data = &m_chunks[page.chunk][page.offset];
+
+        if (page.raw) {
+            std::memcpy(out, data, kPageSize4Kb);
+            return true;
+        }
+
+        return detail::lz_decompress(data, page.size, out, kPageSize4Kb);
+    }
+};   // !class snapshot_store
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_SNAPSHOT_HPP_
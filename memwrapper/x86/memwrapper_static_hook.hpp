@@ -0,0 +1,421 @@
+﻿#ifndef MEMWRAPPER_STATIC_HOOK_HPP_
+#define MEMWRAPPER_STATIC_HOOK_HPP_
+
+namespace memwrapper {
+/**
+ * \brief Size of one static hook slot.
+ */
+constexpr uint32_t kStaticHookSlotSize = 48u;
+/**
+ * \brief Number of static hook slots reserved in the code section.
+ */
+constexpr uint32_t kStaticHookSlots = 64u;
+
+namespace detail {
+/**
+ * Copies whole instructions to other address, rewriting relative calls,
+ * jumps and conditional jumps to rel32 forms, and appends a jump back.
+ *
+ * \param from Code to relocate.
+ * \param size Minimal number of bytes to take.
+ * \param out Output buffer.
+ * \param at Address where the output will be executed.
+ * \param capacity Size of the output buffer.
+ * \param taken Output number of taken bytes (whole instructions).
+ * \return Number of written bytes or zero on failure.
+ */
+inline size_t relocate_instructions(const memory_pointer& from,
+                                    const size_t size, uint8_t* out,
+                                    const memory_pointer& at,
+                                    const size_t capacity, size_t& taken) {
+    size_t written = 0u;
+    taken          = 0u;
+
+    auto emit = [&](const void* data, const size_t length) {
+        if (written + length > capacity)
+            return false;
+
+        std::memcpy(out + written, data, length);
+        written += length;
+        return true;
+    };
+
+    while (taken < size) {
+        auto now = from.cast<const uint8_t*>() + taken;
+
+        hde32s hs;
+        auto   len = hde32_disasm(now, &hs);
+        if (hs.flags & F_ERROR)
+            return 0u;
+
+        auto next = from.addressof() + taken + len;
+        auto here = at.addressof() + written;
+        bool done = false;
+
+        if (hs.opcode == 0xE8) {
+            call_relative call = { 0xE8, 0x00000000u };
+            call.operand = get_relative_address(next + hs.imm.imm32, here);
+            done         = emit(&call, sizeof(call));
+        } else if ((hs.opcode == 0xE9) || (hs.opcode == 0xEB)) {
+            auto destination =
+                next + ((hs.opcode == 0xEB) ? static_cast<int8_t>(hs.imm.imm8)
+                                            : hs.imm.imm32);
+
+            jmp_relative jmp = { 0xE9, 0x00000000u };
+            jmp.operand      = get_relative_address(destination, here);
+            done             = emit(&jmp, sizeof(jmp));
+        } else if (((hs.opcode & 0xF0) == 0x70) ||
+                   ((hs.opcode == 0x0F) && ((hs.opcode2 & 0xF0) == 0x80))) {
+            bool short_jcc   = ((hs.opcode & 0xF0) == 0x70);
+            auto destination =
+                next + (short_jcc ? static_cast<int8_t>(hs.imm.imm8)
+                                  : hs.imm.imm32);
+            uint8_t cond = (short_jcc ? hs.opcode : hs.opcode2) & 0x0F;
+
+            jcc_relative jcc = { 0x0F, static_cast<uint8_t>(0x80 | cond),
+                                 0x00000000u };
+            jcc.operand = get_relative_address(destination, here, sizeof(jcc));
+            done        = emit(&jcc, sizeof(jcc));
+        } else if (hs.flags & F_RELATIVE) {
+            // loop, jecxz and friends have no rel32 form.
+            return 0u;
+        } else {
+            done = emit(now, len);
+        }
+
+        if (!done)
+            return 0u;
+
+        taken += len;
+    }
+
+    // Jumping back to the rest of the code.
+    jmp_relative back = { kJumpOpcode, 0x00000000u };
+    back.operand      = get_relative_address(from.addressof() + taken,
+                                             at.addressof() + written);
+
+    return emit(&back, sizeof(back)) ? written : 0u;
+}
+
+/**
+ * Checks is a jump an entry of an incremental linking table: a run of
+ * \c jmp rel32 \c entries without padding, every entry jumps into the same
+ * module. A hooked function (jumps out of the module) or a function that
+ * starts with a tail jump (padded with int3) isn't one.
+ *
+ * \param at Address of the jump.
+ * \return Is jump an incremental linking thunk.
+ */
+inline bool is_incremental_thunk(const uintptr_t at) {
+    auto module_of = [](const uintptr_t address) -> uintptr_t {
+        MEMORY_BASIC_INFORMATION mbi{ 0 };
+        if (!VirtualQuery(memory_pointer(address), &mbi, sizeof(mbi)) ||
+            (mbi.Type != MEM_IMAGE))
+            return 0u;
+
+        return reinterpret_cast<uintptr_t>(mbi.AllocationBase);
+    };
+
+    auto module = module_of(at);
+    auto entry  = [&](const uintptr_t now) {
+        uint8_t code[kJumpSize];
+        if (detail::read_memory_safe(now, code, sizeof(code)) != sizeof(code) ||
+            (code[0] != kJumpOpcode))
+            return false;
+
+        auto destination = restore_absolute_address(
+            *reinterpret_cast<uint32_t*>(&code[1]), now);
+        return module_of(destination) == module;
+    };
+
+    return module && entry(at) &&
+           (entry(at - kJumpSize) || entry(at + kJumpSize));
+}
+
+/**
+ * \return Is code a \c vcall \c thunk of a pointer to a virtual member
+ * function (mov eax, [ecx]; jmp [eax + N]).
+ */
+inline bool is_vcall_thunk(const uintptr_t at) {
+    auto code = reinterpret_cast<const uint8_t*>(at);
+    return (code[0] == 0x8B) && (code[1] == 0x01) && (code[2] == 0xFF) &&
+           ((code[3] == 0x20) || (code[3] == 0x60) || (code[3] == 0xA0));
+}
+
+/**
+ * Returns the code address of a function or a member function, following
+ * the jump of an incremental linking thunk. Pointers to virtual member
+ * functions are rejected: they point to a \c vcall \c thunk shared by every
+ * virtual call through the same slot.
+ *
+ * \param function Function pointer or member function pointer.
+ * \return Address of the code or zero.
+ */
+template<typename T>
+inline uintptr_t code_address(const T function) {
+    static_assert(sizeof(T) >= sizeof(uintptr_t));
+
+    // The code address goes first for every kind of member pointers.
+    uintptr_t address = 0u;
+    std::memcpy(&address, &function, sizeof(address));
+
+    if (address && is_incremental_thunk(address))
+        address = restore_absolute_address(
+            *reinterpret_cast<uint32_t*>(address + 1u), address);
+
+    if (address && is_vcall_thunk(address))
+        return 0u;
+
+    return address;
+}
+
+/**
+ * \return Does function start with mov edi, edi after five bytes of padding.
+ */
+inline bool is_hotpatchable(const uintptr_t at) {
+    auto code = reinterpret_cast<const uint8_t*>(at);
+    if ((code[0] != 0x8B) || (code[1] != 0xFF))
+        return false;
+
+    for (uint32_t i = 1; i <= kJumpSize; i++) {
+        if ((code[-static_cast<int>(i)] != 0xCC) &&
+            (code[-static_cast<int>(i)] != kNopOpcode))
+            return false;
+    }
+
+    return true;
+}
+
+#if defined(_MSC_VER)
+#define MW_INT3_1 __asm int 3
+#define MW_INT3_4 MW_INT3_1 MW_INT3_1 MW_INT3_1 MW_INT3_1
+#define MW_INT3_16 MW_INT3_4 MW_INT3_4 MW_INT3_4 MW_INT3_4
+#define MW_INT3_64 MW_INT3_16 MW_INT3_16 MW_INT3_16 MW_INT3_16
+#define MW_INT3_256 MW_INT3_64 MW_INT3_64 MW_INT3_64 MW_INT3_64
+#define MW_INT3_1024 MW_INT3_256 MW_INT3_256 MW_INT3_256 MW_INT3_256
+
+/**
+ * Reserved code for static hook trampolines (kStaticHookSlots *
+ * kStaticHookSlotSize bytes). One function, so it's never folded by the
+ * linker.
+ */
+__declspec(naked) __declspec(code_seg(".text$mwslots")) inline void
+static_hook_slots() {
+    MW_INT3_1024
+    MW_INT3_1024
+    MW_INT3_1024
+}
+
+#undef MW_INT3_1024
+#undef MW_INT3_256
+#undef MW_INT3_64
+#undef MW_INT3_16
+#undef MW_INT3_4
+#undef MW_INT3_1
+
+static_assert(kStaticHookSlots * kStaticHookSlotSize == 3u * 1024u,
+              "static_hook_slots() must be resized");
+
+/**
+ * \return Counter of claimed static hook slots.
+ */
+inline std::atomic<uint32_t>& static_hook_next_slot() {
+    static std::atomic<uint32_t> next{ 0u };
+    return next;
+}
+#endif   // defined(_MSC_VER)
+}   // namespace detail
+
+#if defined(_MSC_VER)
+/**
+ * @brief Hook resolved at compile time. Doesn't allocate memory: the
+ * trampoline lives in a slot reserved in the code section of the binary.
+ * Install relocates the prologue into the slot at run time, so the slot and
+ * the target are writable and executable for the duration of the copy.
+ * Hotpatchable functions (mov edi, edi) don't need a slot at all.
+ *
+ * The replacement must have the same calling convention as the target
+ * (\c __thiscall \c or \c __fastcall \c with an unused edx for methods).
+ * Virtual member functions can't be targets: a pointer to one resolves to
+ * a thunk shared by the whole vtable slot, \c install() \c fails.
+ *
+ * @code{.cpp}
+ * int __fastcall on_update(Player* self, void*, float delta);
+ * using update_hook = memwrapper::static_hook<&Player::update, &on_update>;
+ *
+ * update_hook::install();
+ * // ...
+ * update_hook::call(self, delta);
+ * @endcode
+ */
+template<auto Target, auto Replacement>
+class static_hook {
+    using function_t = decltype(Target);
+    using Ret        = detail::return_type_t<function_t>;
+
+    struct state {
+        /**
+         * Address of the original code.
+         */
+        uintptr_t original;
+        /**
+         * Patched bytes.
+         */
+        uintptr_t patched;
+        /**
+         * Size of patched bytes.
+         */
+        size_t patched_size;
+        /**
+         * Original bytes of the patched code.
+         */
+        uint8_t saved[kStaticHookSlotSize];
+        /**
+         * Claimed slot.
+         */
+        uint32_t slot;
+        /**
+         * Is hook installed over mov edi, edi.
+         */
+        bool hotpatch;
+        /**
+         * Is hook installed.
+         */
+        bool installed;
+    };
+
+    static state& get_state() {
+        static state value{ 0u, 0u, 0u, { 0 }, kStaticHookSlots, false, false };
+        return value;
+    }
+
+  public:
+    static_hook() = delete;
+
+    /**
+     * Installs the hook.
+     *
+     * \return Is hook installed.
+     */
+    static bool install() {
+        using detail::get_relative_address;
+
+        auto& now = get_state();
+        if (now.installed)
+            return true;
+
+        auto target = detail::code_address(Target);
+        auto hooker = detail::code_address(Replacement);
+        if (!target || !hooker)
+            return false;
+
+        uint8_t patch[kStaticHookSlotSize];
+
+        if (detail::is_hotpatchable(target)) {
+            // jmp hooker in the padding, jmp $-5 over mov edi, edi.
+            now.patched      = target - kJumpSize;
+            now.patched_size = kJumpSize + 2u;
+
+            patch[0] = kJumpOpcode;
+            *reinterpret_cast<uint32_t*>(&patch[1]) =
+                get_relative_address(hooker, now.patched);
+            patch[5] = 0xEB;
+            patch[6] = 0xF9;
+
+            now.original = target + 2u;
+            now.hotpatch = true;
+        } else {
+            if (now.slot == kStaticHookSlots) {
+                auto slot = detail::static_hook_next_slot().fetch_add(1u);
+                if (slot >= kStaticHookSlots)
+                    return false;
+
+                now.slot = slot;
+            }
+
+            auto slot = detail::code_address(&detail::static_hook_slots) +
+                        now.slot * kStaticHookSlotSize;
+
+            size_t taken = 0u;
+            auto   size  = detail::relocate_instructions(
+                target, kJumpSize, patch, slot, sizeof(patch), taken);
+            if (!size)
+                return false;
+
+            detail::write_trampoline(slot, patch, size);
+
+            now.patched      = target;
+            now.patched_size = taken;
+
+            patch[0] = kJumpOpcode;
+            *reinterpret_cast<uint32_t*>(&patch[1]) =
+                get_relative_address(hooker, target);
+            std::memset(&patch[kJumpSize], kNopOpcode, taken - kJumpSize);
+
+            now.original = slot;
+            now.hotpatch = false;
+        }
+
+        detail::backup_memory(now.saved, now.patched, now.patched_size);
+
+        if (now.hotpatch) {
+            // The long jump must be ready before the short one appears.
+            copy_memory(now.patched, patch, kJumpSize);
+            write_memory(target, *reinterpret_cast<uint16_t*>(&patch[5]));
+        } else {
+            copy_memory(now.patched, patch, now.patched_size);
+        }
+
+        detail::ownership_registry::instance().add(now.patched,
+                                                   now.patched_size);
+
+        now.installed = true;
+        return true;
+    }
+
+    /**
+     * Removes the hook.
+     */
+    static void remove() {
+        auto& now = get_state();
+        if (!now.installed)
+            return;
+
+        if (now.hotpatch) {
+            // Unlinking the short jump first.
+            write_memory(now.patched + kJumpSize,
+                         *reinterpret_cast<uint16_t*>(&now.saved[kJumpSize]));
+            copy_memory(now.patched, now.saved, kJumpSize);
+        } else {
+            copy_memory(now.patched, now.saved, now.patched_size);
+        }
+
+        detail::ownership_registry::instance().remove(now.patched,
+                                                      now.patched_size);
+
+        now.installed = false;
+    }
+
+    /**
+     * \return Is hook installed.
+     */
+    static bool installed() { return get_state().installed; }
+
+    /**
+     * \return Address that executes the original function.
+     */
+    static uintptr_t original() { return get_state().original; }
+
+    /**
+     * Calls the original function.
+     */
+    template<typename... Args>
+    static Ret call(Args... args) {
+        return call_function<Ret, detail::call_convention_v<function_t>>(
+            get_state().original, std::forward<Args>(args)...);
+    }
+};   // !class static_hook
+#endif   // defined(_MSC_VER)
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_STATIC_HOOK_HPP_
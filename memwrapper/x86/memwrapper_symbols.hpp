@@ -0,0 +1,633 @@
+﻿#ifndef MEMWRAPPER_SYMBOLS_HPP_
+#define MEMWRAPPER_SYMBOLS_HPP_
+
+namespace memwrapper {
+/**
+ * @brief Resolved address. Views are valid until the next
+ * \c symbolizer::refresh() \c.
+ */
+struct symbol_info {
+    /**
+     * File name of the module.
+     */
+    std::string_view module;
+    /**
+     * Name of the symbol, empty if the address has no symbol.
+     */
+    std::string_view name;
+    /**
+     * Start of the symbol (base of the module if there's no symbol).
+     */
+    uintptr_t address;
+    /**
+     * Offset of the address from the start.
+     */
+    uint32_t offset;
+};   // !struct symbol_info
+
+namespace detail {
+/**
+ * \brief Size of the build key (CodeView GUID and age).
+ */
+constexpr uint32_t kBuildKeySize       = 20u;
+constexpr uint32_t kSymbolCacheMagic   = 0x5953574Du;   // MWSY
+constexpr uint32_t kSymbolCacheVersion = 1u;
+
+/**
+ * @brief Header of a symbol table, followed by sorted relative virtual
+ * addresses, offsets of the names and the pool of names.
+ */
+struct symbol_cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint8_t  key[kBuildKeySize];
+    uint32_t count;
+    uint32_t pool_size;
+};   // !struct symbol_cache_header
+
+/**
+ * Identifies a build of a module by the CodeView GUID and age, or by the
+ * timestamp and the size of the image when there's no debug record.
+ *
+ * \param image Loaded image.
+ * \param key Output key.
+ */
+inline void get_build_key(const image_view& image,
+                          uint8_t (&key)[kBuildKeySize]) {
+    std::memset(key, 0, sizeof(key));
+    if (!image.good())
+        return;
+
+    auto dir   = image.directory(IMAGE_DIRECTORY_ENTRY_DEBUG);
+    auto debug = image.base().front(dir.VirtualAddress)
+                     .cast<const IMAGE_DEBUG_DIRECTORY*>();
+
+    for (size_t i = 0; dir.VirtualAddress &&
+                       (i < dir.Size / sizeof(IMAGE_DEBUG_DIRECTORY));
+         i++, debug++) {
+        if ((debug->Type != IMAGE_DEBUG_TYPE_CODEVIEW) ||
+            (debug->SizeOfData < sizeof(uint32_t) + kBuildKeySize) ||
+            !debug->AddressOfRawData)
+            continue;
+
+        // RSDS, GUID, age.
+        auto record = image.base().front(debug->AddressOfRawData)
+                          .cast<const uint8_t*>();
+        if (*reinterpret_cast<const uint32_t*>(record) != 0x53445352u)
+            continue;
+
+        std::memcpy(key, record + sizeof(uint32_t), kBuildKeySize);
+        return;
+    }
+
+    auto stamp = image.nt()->FileHeader.TimeDateStamp;
+    auto size  = image.image_size();
+    std::memcpy(&key[0], &stamp, sizeof(stamp));
+    std::memcpy(&key[sizeof(stamp)], &size, sizeof(size));
+}
+
+/**
+ * @brief Sorted symbols of one module, built from exports and COFF
+ * symbols or mapped from a cache file.
+ */
+class symbol_table {
+  protected:
+    /**
+     * Built table.
+     */
+    std::vector<uint8_t> m_storage;
+    /**
+     * Handle of the mapped cache file.
+     */
+    HANDLE m_file;
+    /**
+     * Handle of the mapping.
+     */
+    HANDLE m_mapping;
+    /**
+     * Mapped cache file.
+     */
+    void* m_view;
+    /**
+     * Header of the table.
+     */
+    const symbol_cache_header* m_header;
+    /**
+     * Sorted relative virtual addresses.
+     */
+    const uint32_t* m_rvas;
+    /**
+     * Offsets of the names in the pool.
+     */
+    const uint32_t* m_names;
+    /**
+     * Pool of zero terminated names.
+     */
+    const char* m_pool;
+
+  public:
+    symbol_table(const symbol_table&) = delete;
+    symbol_table(symbol_table&&)      = delete;
+
+    symbol_table()
+        : m_file(INVALID_HANDLE_VALUE)
+        , m_mapping(NULL)
+        , m_view(nullptr)
+        , m_header(nullptr)
+        , m_rvas(nullptr)
+        , m_names(nullptr)
+        , m_pool(nullptr) {}
+
+    /**
+     * Destructor. Unmaps the cache file.
+     */
+    ~symbol_table() { close(); }
+
+    /**
+     * Builds the table from exports and COFF symbols of a loaded module.
+     *
+     * \param handle Base address of the module.
+     * \return Is table built.
+     */
+    bool build(const HMODULE handle) {
+        close();
+
+        image_view image(handle);
+        if (!image.good())
+            return false;
+
+        std::vector<std::pair<uint32_t, std::string>> symbols;
+        add_exports(image, symbols);
+        add_coff_symbols(image, handle, symbols);
+
+        // Exports go first, so their names win.
+        std::stable_sort(symbols.begin(), symbols.end(),
+                         [](const auto& a, const auto& b) {
+                             return a.first < b.first;
+                         });
+        symbols.erase(std::unique(symbols.begin(), symbols.end(),
+                                  [](const auto& a, const auto& b) {
+                                      return a.first == b.first;
+                                  }),
+                      symbols.end());
+
+        symbol_cache_header header{ kSymbolCacheMagic, kSymbolCacheVersion };
+        get_build_key(image, header.key);
+        header.count = static_cast<uint32_t>(symbols.size());
+
+        std::string pool;
+        for (auto& now : symbols)
+            pool.append(now.second).push_back('\0');
+
+        header.pool_size = static_cast<uint32_t>(pool.size());
+
+        auto arrays = header.count * sizeof(uint32_t);
+        m_storage.resize(sizeof(header) + 2u * arrays + pool.size());
+
+        auto rvas  = reinterpret_cast<uint32_t*>(&m_storage[sizeof(header)]);
+        auto names = rvas + header.count;
+        for (uint32_t i = 0, offset = 0; i < header.count; i++) {
+            rvas[i]  = symbols[i].first;
+            names[i] = offset;
+            offset += static_cast<uint32_t>(symbols[i].second.size()) + 1u;
+        }
+
+        std::memcpy(m_storage.data(), &header, sizeof(header));
+        std::memcpy(&m_storage[sizeof(header) + 2u * arrays], pool.data(),
+                    pool.size());
+
+        return attach(m_storage.data(), m_storage.size());
+    }
+
+    /**
+     * Maps a table saved by \c save() \c.
+     *
+     * \param path Path to the cache file.
+     * \param key Expected build key.
+     * \return Is table mapped.
+     */
+    bool load(std::string_view path, const uint8_t (&key)[kBuildKeySize]) {
+        close();
+
+        m_file = CreateFile(std::string(path).c_str(), GENERIC_READ,
+                            FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL, NULL);
+        if (m_file == INVALID_HANDLE_VALUE)
+            return false;
+
+        auto size = GetFileSize(m_file, NULL);
+        m_mapping = CreateFileMapping(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping)
+            m_view = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+
+        if (!m_view || !attach(static_cast<const uint8_t*>(m_view), size) ||
+            std::memcmp(m_header->key, key, kBuildKeySize)) {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * Saves the table.
+     *
+     * \param path Path to the cache file.
+     * \return Is table saved.
+     */
+    bool save(std::string_view path) const {
+        if (!good())
+            return false;
+
+        auto file = CreateFile(std::string(path).c_str(), GENERIC_WRITE, 0,
+                               NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL,
+                               NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        auto  size    = static_cast<DWORD>(data_size());
+        DWORD written = 0;
+        bool  result  = WriteFile(file, m_header, size, &written, NULL) &&
+                      (written == size);
+
+        CloseHandle(file);
+        return result;
+    }
+
+    /**
+     * Finds the symbol that contains a relative virtual address.
+     *
+     * \param rva Relative virtual address.
+     * \param start Output start of the symbol.
+     * \return Name of the symbol or nullptr.
+     */
+    const char* find(const uint32_t rva, uint32_t& start) const {
+        if (!good())
+            return nullptr;
+
+        auto end = m_rvas + m_header->count;
+        auto it  = std::upper_bound(m_rvas, end, rva);
+        if (it == m_rvas)
+            return nullptr;
+
+        auto index = static_cast<size_t>(--it - m_rvas);
+        start      = *it;
+        return m_pool + m_names[index];
+    }
+
+    /**
+     * \return Number of symbols.
+     */
+    uint32_t size() const { return good() ? m_header->count : 0u; }
+    /**
+     * \return Is table built or mapped.
+     */
+    bool good() const { return (m_header != nullptr); }
+
+  private:
+    size_t data_size() const {
+        return sizeof(symbol_cache_header) +
+               2u * m_header->count * sizeof(uint32_t) + m_header->pool_size;
+    }
+
+    bool attach(const uint8_t* data, const size_t size) {
+        auto header = reinterpret_cast<const symbol_cache_header*>(data);
+        if ((size < sizeof(symbol_cache_header)) ||
+            (header->magic != kSymbolCacheMagic) ||
+            (header->version != kSymbolCacheVersion))
+            return false;
+
+        auto arrays = static_cast<uint64_t>(header->count) * sizeof(uint32_t);
+        if (sizeof(symbol_cache_header) + 2u * arrays + header->pool_size >
+            size)
+            return false;
+
+        auto rvas  = reinterpret_cast<const uint32_t*>(header + 1);
+        auto names = rvas + header->count;
+        auto pool  = reinterpret_cast<const char*>(names + header->count);
+
+        // Names of a mapped file must stay inside the pool.
+        if (header->count &&
+            (!header->pool_size || pool[header->pool_size - 1u]))
+            return false;
+
+        for (uint32_t i = 0; i < header->count; i++) {
+            if (names[i] >= header->pool_size)
+                return false;
+        }
+
+        m_header = header;
+        m_rvas   = rvas;
+        m_names  = names;
+        m_pool   = pool;
+        return true;
+    }
+
+    void close() {
+        m_header = nullptr;
+        m_rvas   = nullptr;
+        m_names  = nullptr;
+        m_pool   = nullptr;
+        m_storage.clear();
+
+        if (m_view)
+            UnmapViewOfFile(m_view);
+
+        if (m_mapping)
+            CloseHandle(m_mapping);
+
+        if (m_file != INVALID_HANDLE_VALUE)
+            CloseHandle(m_file);
+
+        m_view    = nullptr;
+        m_mapping = NULL;
+        m_file    = INVALID_HANDLE_VALUE;
+    }
+
+    static void
+    add_exports(const image_view&                              image,
+                std::vector<std::pair<uint32_t, std::string>>& symbols) {
+        auto dir = image.directory(IMAGE_DIRECTORY_ENTRY_EXPORT);
+        if (!dir.VirtualAddress || !dir.Size)
+            return;
+
+        auto base    = image.base();
+        auto exports = base.front(dir.VirtualAddress)
+                           .cast<const IMAGE_EXPORT_DIRECTORY*>();
+        auto functions =
+            base.front(exports->AddressOfFunctions).cast<const uint32_t*>();
+        auto names =
+            base.front(exports->AddressOfNames).cast<const uint32_t*>();
+        auto ordinals =
+            base.front(exports->AddressOfNameOrdinals).cast<const uint16_t*>();
+
+        std::vector<const char*> named(exports->NumberOfFunctions, nullptr);
+        for (uint32_t i = 0; i < exports->NumberOfNames; i++) {
+            if (ordinals[i] < named.size())
+                named[ordinals[i]] = base.front(names[i]).cast<const char*>();
+        }
+
+        for (uint32_t i = 0; i < exports->NumberOfFunctions; i++) {
+            auto rva = functions[i];
+
+            // Forwarders point into the export directory.
+            if (!rva || ((rva >= dir.VirtualAddress) &&
+                         (rva < dir.VirtualAddress + dir.Size)))
+                continue;
+
+            symbols.emplace_back(rva, named[i] ? std::string(named[i])
+                                               : "#" + std::to_string(
+                                                           exports->Base + i));
+        }
+    }
+
+    static void
+    add_coff_symbols(const image_view& image, const HMODULE handle,
+                     std::vector<std::pair<uint32_t, std::string>>& symbols) {
+        auto header = image.nt()->FileHeader;
+        if (!header.PointerToSymbolTable || !header.NumberOfSymbols)
+            return;
+
+        // The symbol table isn't mapped into memory.
+        module_file file(handle);
+        auto        table_size =
+            static_cast<uint64_t>(header.NumberOfSymbols) * IMAGE_SIZEOF_SYMBOL;
+        if (!file.good() || (header.PointerToSymbolTable + table_size +
+                                 sizeof(uint32_t) >
+                             file.file_size()))
+            return;
+
+        auto table   = file.base().front(header.PointerToSymbolTable)
+                         .cast<const uint8_t*>();
+        auto strings = table + table_size;
+        auto strings_size =
+            (std::min)(*reinterpret_cast<const uint32_t*>(strings),
+                       static_cast<uint32_t>(file.file_size() -
+                                             header.PointerToSymbolTable -
+                                             table_size));
+
+        for (uint32_t i = 0; i < header.NumberOfSymbols; i++) {
+            auto symbol = reinterpret_cast<const IMAGE_SYMBOL*>(
+                table + i * IMAGE_SIZEOF_SYMBOL);
+            // Special section numbers are negative.
+            auto section = static_cast<uint32_t>(symbol->SectionNumber);
+            auto aux     = symbol->NumberOfAuxSymbols;
+
+            if ((section > 0) && (section <= image.sections_count()) &&
+                (ISFCN(symbol->Type) ||
+                 (symbol->StorageClass == IMAGE_SYM_CLASS_EXTERNAL)) &&
+                is_executable_section(image.sections()[section - 1])) {
+                std::string name;
+                if (symbol->N.Name.Short) {
+                    auto short_name =
+                        reinterpret_cast<const char*>(symbol->N.ShortName);
+                    name.assign(short_name,
+                                std::find(short_name, short_name + 8, '\0'));
+                } else if (symbol->N.Name.Long < strings_size) {
+                    auto long_name =
+                        reinterpret_cast<const char*>(strings) +
+                        symbol->N.Name.Long;
+                    name.assign(long_name,
+                                std::find(long_name,
+                                          reinterpret_cast<const char*>(
+                                              strings) + strings_size,
+                                          '\0'));
+                }
+
+                auto rva = image.sections()[section - 1].VirtualAddress +
+                           symbol->Value;
+                if (!name.empty() && (rva < image.image_size()))
+                    symbols.emplace_back(rva, std::move(name));
+            }
+
+            i += aux;
+        }
+    }
+};   // !class symbol_table
+}   // namespace detail
+
+/**
+ * @brief Resolves addresses to module and symbol names.
+ *
+ * Symbols come from exports and COFF symbols (no PDB). Tables are built
+ * on the first lookup in a module, and if a cache directory is set they
+ * are saved there and mapped back on later runs, keyed by the build of
+ * the module. Lookups are binary searches over sorted addresses.
+ *
+ * @code{.cpp}
+ * memwrapper::symbolizer symbols{ "C:\\cache" };
+ *
+ * memwrapper::symbol_info info;
+ * if (symbols.resolve(0x00401234, info))
+ *     std::cout << info.module << "!" << info.name << "+" << info.offset;
+ * @endcode
+ */
+class symbolizer {
+    struct module_entry {
+        std::string                          name;
+        uintptr_t                            base;
+        uintptr_t                            end;
+        std::unique_ptr<detail::symbol_table> table;
+    };
+
+  protected:
+    /**
+     * Loaded modules sorted by base.
+     */
+    std::vector<module_entry> m_modules;
+    /**
+     * Directory of cache files, empty if tables aren't saved.
+     */
+    std::string m_cache_directory;
+
+  public:
+    symbolizer(const symbolizer&) = delete;
+    symbolizer(symbolizer&&)      = delete;
+
+    /**
+     * Constructor.
+     *
+     * \param cache_directory Directory of cache files (optional).
+     */
+    explicit symbolizer(std::string_view cache_directory = {})
+        : m_cache_directory(cache_directory) {
+        refresh();
+    }
+
+    /**
+     * Updates the list of loaded modules, keeping tables of modules that
+     * are still loaded.
+     */
+    void refresh() {
+        std::vector<module_entry> modules;
+        for (auto& module : loaded_modules()) {
+            module_entry entry{ module.name, module.base,
+                                module.base + module.size, nullptr };
+
+            auto old = find_module(module.base);
+            if (old && (old->base == entry.base) && (old->end == entry.end) &&
+                (old->name == entry.name))
+                entry.table = std::move(old->table);
+
+            modules.push_back(std::move(entry));
+        }
+
+        std::sort(modules.begin(), modules.end(),
+                  [](const module_entry& a, const module_entry& b) {
+                      return a.base < b.base;
+                  });
+
+        m_modules = std::move(modules);
+    }
+
+    /**
+     * Resolves an address.
+     *
+     * \param at Address.
+     * \param out Output symbol.
+     * \return Is address inside a loaded module.
+     */
+    bool resolve(const memory_pointer& at, symbol_info& out) {
+        auto module = find_module(at.addressof());
+        return module && resolve(*module, at.addressof(), out);
+    }
+
+    /**
+     * Resolves a batch of addresses in the order of addresses, so every
+     * module is searched once per run of its addresses.
+     *
+     * \param addresses Addresses.
+     * \param count Number of addresses.
+     * \param out Output symbols (zeroed for addresses outside modules).
+     * \return Number of resolved addresses.
+     */
+    size_t resolve(const uintptr_t* addresses, const size_t count,
+                   symbol_info* out) {
+        std::vector<uint32_t> order(count);
+        for (uint32_t i = 0; i < count; i++)
+            order[i] = i;
+
+        std::sort(order.begin(), order.end(),
+                  [&](const uint32_t a, const uint32_t b) {
+                      return addresses[a] < addresses[b];
+                  });
+
+        module_entry* module   = nullptr;
+        size_t        resolved = 0u;
+
+        for (auto index : order) {
+            auto at = addresses[index];
+            if (!module || (at < module->base) || (at >= module->end))
+                module = find_module(at);
+
+            if (module && resolve(*module, at, out[index]))
+                resolved++;
+            else
+                out[index] = {};
+        }
+
+        return resolved;
+    }
+
+    /**
+     * \return Number of loaded modules.
+     */
+    size_t modules_count() const { return m_modules.size(); }
+
+  private:
+    module_entry* find_module(const uintptr_t at) {
+        auto it = std::upper_bound(m_modules.begin(), m_modules.end(), at,
+                                   [](const uintptr_t     address,
+                                      const module_entry& module) {
+                                       return address < module.base;
+                                   });
+        if (it == m_modules.begin() || (at >= (--it)->end))
+            return nullptr;
+
+        return &*it;
+    }
+
+    bool resolve(module_entry& module, const uintptr_t at, symbol_info& out) {
+        if (!module.table)
+            module.table = open_table(module);
+
+        uint32_t rva   = static_cast<uint32_t>(at - module.base);
+        uint32_t start = 0u;
+        auto     name  = module.table->find(rva, start);
+
+        out.module  = module.name;
+        out.name    = name ? name : std::string_view();
+        out.address = module.base + start;
+        out.offset  = rva - start;
+        return true;
+    }
+
+    std::unique_ptr<detail::symbol_table>
+    open_table(const module_entry& module) {
+        auto table  = std::make_unique<detail::symbol_table>();
+        auto handle = reinterpret_cast<HMODULE>(module.base);
+
+        if (m_cache_directory.empty()) {
+            table->build(handle);
+            return table;
+        }
+
+        uint8_t key[detail::kBuildKeySize];
+        detail::get_build_key(image_view(module.base), key);
+
+        std::string path = m_cache_directory + "\\" + module.name + ".";
+        for (auto byte : key) {
+            path.push_back("0123456789abcdef"[byte >> 4]);
+            path.push_back("0123456789abcdef"[byte & 0xF]);
+        }
+        path += ".mwsym";
+
+        if (!table->load(path, key) && table->build(handle))
+            table->save(path);
+
+        return table;
+    }
+};   // !class symbolizer
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_SYMBOLS_HPP_
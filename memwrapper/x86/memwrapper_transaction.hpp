@@ -0,0 +1,432 @@
+﻿#ifndef MEMWRAPPER_TRANSACTION_HPP_
+#define MEMWRAPPER_TRANSACTION_HPP_
+
+namespace memwrapper {
+/**
+ * How a write transaction writes into protected memory.
+ */
+enum class WriteStrategy {
+    /**
+     * One \c VirtualProtect \c pair and one flush per memory region.
+     */
+    Protect,
+    /**
+     * One \c WriteProcessMemory \c call per run of adjacent writes. On the
+     * own process every call changes the protection, writes, restores it and
+     * flushes by itself, so it never makes fewer system calls than
+     * \c Protect \c.
+     */
+    Direct,
+    /**
+     * Cheaper of both by the measured cost of each. The first commit of the
+     * process measures them on a scratch page.
+     */
+    Auto
+};
+
+namespace detail {
+/**
+ * @brief Measured costs of both write strategies (in QPC ticks).
+ */
+struct write_costs {
+    /**
+     * Protection change, write, restore and flush of one region.
+     */
+    double protect;
+    /**
+     * One \c WriteProcessMemory \c call.
+     */
+    double direct;
+};   // !struct write_costs
+
+/**
+ * Measures costs of both write strategies once on a scratch code page.
+ *
+ * \return Measured costs.
+ */
+inline const write_costs& measure_write_costs() {
+    static const write_costs costs = []() {
+        // Direct writes are never chosen if measurement fails.
+        write_costs result{ 1.0, 1e30 };
+
+        auto page = reinterpret_cast<uint8_t*>(VirtualAlloc(
+            NULL, kPageSize4Kb, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READ));
+        if (!page)
+            return result;
+
+        constexpr uint32_t kRounds = 16u;
+        uint8_t            value   = 0xC3;
+        bool               direct  = true;
+
+        LARGE_INTEGER start, middle, stop;
+        QueryPerformanceCounter(&start);
+
+        for (uint32_t i = 0; i < kRounds; i++) {
+            scoped_unprotect unprotect(page + i, sizeof(value));
+            page[i] = value;
+            flush_memory(page + i, sizeof(value));
+        }
+
+        QueryPerformanceCounter(&middle);
+
+        for (uint32_t i = 0; i < kRounds; i++)
+            direct &= (WriteProcessMemory(GetCurrentProcess(), page + i, &value,
+                                          sizeof(value), NULL) != 0);
+
+        QueryPerformanceCounter(&stop);
+        VirtualFree(page, 0, MEM_RELEASE);
+
+        double protect_ticks = static_cast<double>(middle.QuadPart) -
+                               static_cast<double>(start.QuadPart);
+        double direct_ticks  = static_cast<double>(stop.QuadPart) -
+                              static_cast<double>(middle.QuadPart);
+
+        result.protect = (std::max)(protect_ticks / kRounds, 1.0);
+        if (direct)
+            result.direct = (std::max)(direct_ticks / kRounds, 1.0);
+
+        return result;
+    }();
+
+    return costs;
+}
+}   // namespace detail
+
+/**
+ * @brief Batched write of many memory ranges.
+ *
+ * Writes are grouped by memory region: every group of writes that share the
+ * same region costs one protection change, one restore and one instruction
+ * cache flush, instead of a pair of \c VirtualProtect \c calls per write.
+ * Overlapping writes are applied in the order they were added.
+ *
+ * Alternatively a group is written with one \c WriteProcessMemory \c call
+ * per run of adjacent writes (\c WriteStrategy::Direct \c). It saves no
+ * system calls on Windows: \c WriteProcessMemory \c does its own protection
+ * change, restore and flush per call. \c WriteStrategy::Auto \c picks one
+ * per group by measured costs.
+ *
+ * @code{.cpp}
+ * memwrapper::write_transaction transaction;
+ * transaction.add(0x00401000, "\x90\x90", 2);
+ * transaction.fill(0x00401010, 0x90, 5);
+ * transaction.commit();
+ * @endcode
+ */
+class write_transaction {
+    struct entry {
+        uintptr_t address;
+        uint32_t  offset;
+        uint32_t  size;
+    };
+
+  protected:
+    /**
+     * Pending writes.
+     */
+    std::vector<entry> m_entries;
+    /**
+     * Data of pending writes.
+     */
+    std::vector<uint8_t> m_data;
+    /**
+     * Strategy of writing.
+     */
+    WriteStrategy m_strategy;
+    /**
+     * Order of writes and writes of one region, kept between commits.
+     */
+    std::vector<uint32_t> m_order, m_batch;
+    /**
+     * Bytes written by the last commit.
+     */
+    size_t m_written;
+    /**
+     * Writes skipped by the last commit.
+     */
+    size_t m_skipped;
+
+  public:
+    write_transaction(const write_transaction&) = delete;
+    write_transaction(write_transaction&&)      = default;
+
+    /**
+     * Constructor.
+     *
+     * \param strategy Strategy of writing.
+     */
+    explicit write_transaction(
+        const WriteStrategy strategy = WriteStrategy::Protect)
+        : m_strategy(strategy)
+        , m_written(0u)
+        , m_skipped(0u) {}
+
+    /**
+     * Adds a write.
+     *
+     * \param at Destination.
+     * \param data Data that will be written.
+     * \param size Size of data.
+     */
+    void add(const memory_pointer& at, const memory_pointer& data,
+             const size_t size) {
+        if (!size)
+            return;
+
+        auto offset = static_cast<uint32_t>(m_data.size());
+        auto bytes  = data.cast<const uint8_t*>();
+
+        m_data.insert(m_data.end(), bytes, bytes + size);
+        m_entries.push_back(
+            { at.addressof(), offset, static_cast<uint32_t>(size) });
+    }
+
+    /**
+     * Adds a write.
+     *
+     * \param at Destination.
+     * \param data Bytes that will be written.
+     */
+    void add(const memory_pointer& at, const std::vector<uint8_t>& data) {
+        add(at, data.data(), data.size());
+    }
+
+    /**
+     * Adds a write of a value.
+     *
+     * \param at Destination.
+     * \param value Value that will be written.
+     */
+    template<typename T>
+    void add_value(const memory_pointer& at, const T value) {
+        add(at, &value, sizeof(T));
+    }
+
+    /**
+     * Adds a fill.
+     *
+     * \param at Destination.
+     * \param value Byte that will be written.
+     * \param size Number of bytes.
+     */
+    void fill(const memory_pointer& at, const int value, const size_t size) {
+        if (!size)
+            return;
+
+        auto offset = static_cast<uint32_t>(m_data.size());
+
+        m_data.insert(m_data.end(), size, static_cast<uint8_t>(value));
+        m_entries.push_back(
+            { at.addressof(), offset, static_cast<uint32_t>(size) });
+    }
+
+    /**
+     * Applies all pending writes and clears the transaction. Writes into
+     * memory that isn't committed or can't be unprotected are skipped, see
+     * \c written() \c and \c skipped() \c.
+     *
+     * \return Number of protection changes made.
+     */
+    size_t commit() {
+        size_t batches = 0u;
+        m_written      = 0u;
+        m_skipped      = 0u;
+        if (m_entries.empty())
+            return batches;
+
+        // Sorting by address, keeping the order for equal addresses.
+        auto& order = m_order;
+        order.resize(m_entries.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+            order[i] = i;
+
+        // Ties are broken by index instead of std::stable_sort, which
+        // allocates a buffer on every commit.
+        std::sort(order.begin(), order.end(),
+                  [this](const uint32_t a, const uint32_t b) {
+                      auto first  = m_entries[a].address;
+                      auto second = m_entries[b].address;
+                      return (first != second) ? (first < second) : (a < b);
+                  });
+
+        auto&  batch = m_batch;
+        size_t now   = 0u;
+        while (now < order.size()) {
+            auto& first = m_entries[order[now]];
+
+            MEMORY_BASIC_INFORMATION mbi{ 0 };
+            if (!VirtualQuery(memory_pointer(first.address), &mbi,
+                              sizeof(mbi))) {
+                m_skipped++;
+                now++;
+                continue;
+            }
+
+            auto region_end = reinterpret_cast<uintptr_t>(mbi.BaseAddress) +
+                              mbi.RegionSize;
+
+            // Skipping writes into the reserved or free region.
+            if (mbi.State != MEM_COMMIT) {
+                while ((now < order.size()) &&
+                       (m_entries[order[now]].address < region_end)) {
+                    m_skipped++;
+                    now++;
+                }
+                continue;
+            }
+
+            // Collecting writes that fit in the same region.
+            uintptr_t begin = first.address;
+            uintptr_t end   = first.address + first.size;
+
+            batch.clear();
+            batch.push_back(order[now++]);
+
+            while (now < order.size()) {
+                auto& next = m_entries[order[now]];
+                if (next.address + next.size > region_end)
+                    break;
+
+                end = (std::max)(end, next.address + next.size);
+                batch.push_back(order[now++]);
+            }
+
+            // Overlapping writes must be applied in the order of adding.
+            std::sort(batch.begin(), batch.end());
+
+            if (apply_batch(begin, end, batch)) {
+                for (auto index : batch)
+                    m_written += m_entries[index].size;
+            } else
+                m_skipped += batch.size();
+
+            batches++;
+        }
+
+        clear();
+        return batches;
+    }
+
+    /**
+     * \return Number of bytes written by the last commit.
+     */
+    size_t written() const { return m_written; }
+
+    /**
+     * \return Number of writes skipped by the last commit.
+     */
+    size_t skipped() const { return m_skipped; }
+
+    /**
+     * Drops all pending writes.
+     */
+    void clear() {
+        m_entries.clear();
+        m_data.clear();
+    }
+
+    /**
+     * \return Number of pending writes.
+     */
+    size_t size() const { return m_entries.size(); }
+
+    /**
+     * \return Is transaction empty.
+     */
+    bool empty() const { return m_entries.empty(); }
+
+    /**
+     * \return Strategy of writing.
+     */
+    WriteStrategy strategy() const { return m_strategy; }
+
+  private:
+    struct run {
+        uintptr_t begin;
+        uintptr_t end;
+        size_t    offset;
+    };
+
+    bool apply_batch(const uintptr_t begin, const uintptr_t end,
+                     const std::vector<uint32_t>& batch) {
+        if ((m_strategy != WriteStrategy::Protect) && write_direct(batch))
+            return true;
+
+        // Unprotecting the whole batch at once.
+        scoped_unprotect unprotect(begin, end - begin);
+        if (!unprotect.good())
+            return false;
+
+        for (auto index : batch) {
+            auto& write = m_entries[index];
+            std::memcpy(memory_pointer(write.address),
+                        &m_data[write.offset], write.size);
+        }
+
+        // Flushing information about this batch in CPU.
+        flush_memory(begin, end - begin);
+        return true;
+    }
+
+    bool write_direct(const std::vector<uint32_t>& batch) {
+        // Joining adjacent and overlapping writes into runs.
+        std::vector<uint32_t> sorted(batch);
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [this](const uint32_t a, const uint32_t b) {
+                             return m_entries[a].address < m_entries[b].address;
+                         });
+
+        std::vector<run> runs;
+        for (auto index : sorted) {
+            auto& write = m_entries[index];
+            if (!runs.empty() && (write.address <= runs.back().end))
+                runs.back().end =
+                    (std::max)(runs.back().end, write.address + write.size);
+            else
+                runs.push_back(
+                    { write.address, write.address + write.size, 0u });
+        }
+
+        if (m_strategy == WriteStrategy::Auto) {
+            auto& costs = detail::measure_write_costs();
+            if (runs.size() * costs.direct >= costs.protect)
+                return false;
+        }
+
+        size_t total = 0u;
+        for (auto& now : runs) {
+            now.offset = total;
+            total += now.end - now.begin;
+        }
+
+        // Composing runs in the order of adding.
+        auto by_begin = [](const uintptr_t at, const run& now) {
+            return at < now.begin;
+        };
+
+        std::vector<uint8_t> buffer(total);
+        for (auto index : batch) {
+            auto& write = m_entries[index];
+            auto  owner = std::upper_bound(runs.begin(), runs.end(),
+                                           write.address, by_begin) -
+                         1;
+
+            std::memcpy(&buffer[owner->offset + (write.address - owner->begin)],
+                        &m_data[write.offset], write.size);
+        }
+
+        // Falling back to the protection change on failure.
+        for (auto& now : runs) {
+            if (!WriteProcessMemory(GetCurrentProcess(),
+                                    memory_pointer(now.begin),
+                                    &buffer[now.offset], now.end - now.begin,
+                                    NULL))
+                return false;
+        }
+
+        return true;
+    }
+};   // !class write_transaction
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_TRANSACTION_HPP_
@@ -0,0 +1,100 @@
+﻿#ifndef MEMWRAPPER_UNHOOK_HPP_
+#define MEMWRAPPER_UNHOOK_HPP_
+
+namespace memwrapper {
+/**
+ * What \c restore_module_code \c is allowed to restore.
+ */
+enum class RestoreMode {
+    /**
+     * Every range, including memwrapper's own hooks and patches.
+     */
+    All,
+    /**
+     * Only ranges that aren't owned by memwrapper hooks and patches.
+     */
+    Foreign
+};
+
+/**
+ * Restores ranges of a module from its file on disk with relocations
+ * applied. All writes are done in one \c write_transaction \c. Data the
+ * loader fills (see \c code_diff::loader_ranges \c) is never restored, in
+ * any mode.
+ *
+ * \param diff Comparison of the module with its file.
+ * \param ranges Ranges returned by \c code_diff::compare \c.
+ * \param mode What ranges are allowed to be restored.
+ * \return Number of restored bytes, writes into unmapped or protected
+ * memory aren't counted.
+ */
+inline size_t restore_module_code(const code_diff&                    diff,
+                                  const std::vector<code_diff_range>& ranges,
+                                  const RestoreMode mode = RestoreMode::Foreign) {
+    if (!diff.good())
+        return 0u;
+
+    auto skipped = diff.loader_ranges();
+    if (mode == RestoreMode::Foreign) {
+        auto owned = detail::ownership_registry::instance().snapshot();
+        skipped.insert(skipped.end(), owned.begin(), owned.end());
+        std::sort(skipped.begin(), skipped.end(),
+                  [](const owned_range& a, const owned_range& b) {
+                      return a.begin < b.begin;
+                  });
+    }
+
+    auto base = diff.image().base().addressof();
+
+    write_transaction    transaction;
+    std::vector<uint8_t> buf;
+
+    auto restore = [&](const uintptr_t begin, const uintptr_t end) {
+        if (begin >= end)
+            return;
+
+        buf.resize(end - begin);
+        if (!diff.expected_bytes(begin - base, buf.data(),
+                                 static_cast<uint32_t>(buf.size())))
+            return;
+
+        transaction.add(begin, buf);
+    };
+
+    for (auto& range : ranges) {
+        uintptr_t now = range.address;
+        uintptr_t end = range.address + range.size;
+
+        // Cutting owned and loader ranges out of the range.
+        for (auto& skip : skipped) {
+            if (skip.end <= now)
+                continue;
+            if (skip.begin >= end)
+                break;
+
+            restore(now, (std::min)(skip.begin, end));
+            now = (std::max)(now, skip.end);
+        }
+
+        restore(now, end);
+    }
+
+    transaction.commit();
+    return transaction.written();
+}
+
+/**
+ * Restores all code of a module that differs from its file on disk.
+ *
+ * \param mod The module to unhook. (example.dll, process.exe)
+ * \param mode What ranges are allowed to be restored.
+ * \return Number of restored bytes.
+ */
+inline size_t unhook_module(std::string_view  mod,
+                            const RestoreMode mode = RestoreMode::Foreign) {
+    code_diff diff(mod);
+    return restore_module_code(diff, diff.compare(), mode);
+}
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_UNHOOK_HPP_
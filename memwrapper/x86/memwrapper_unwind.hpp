@@ -0,0 +1,234 @@
+﻿#ifndef MEMWRAPPER_UNWIND_HPP_
+#define MEMWRAPPER_UNWIND_HPP_
+
+namespace memwrapper {
+/**
+ * \brief Maximal number of cached code ranges.
+ */
+constexpr uint32_t kMaxCodeRanges = 512u;
+/**
+ * \brief Maximal number of dwords checked by the stack scan.
+ */
+constexpr uint32_t kMaxStackScan = 2048u;
+
+/**
+ * @brief Range of executable code.
+ */
+struct code_range {
+    uintptr_t begin;
+    uintptr_t end;
+};   // !struct code_range
+
+namespace detail {
+/**
+ * @brief Fixed-size table of executable sections of loaded modules.
+ *
+ * Lookups don't allocate or lock. \c refresh() \c fills the inactive copy
+ * and switches to it, so a lookup racing two refreshes may see a torn
+ * table, which only makes the stack scan less accurate.
+ */
+class code_range_cache {
+  protected:
+    /**
+     * Sorted ranges of both copies.
+     */
+    code_range m_ranges[2][kMaxCodeRanges];
+    /**
+     * Number of ranges of both copies.
+     */
+    std::atomic<uint32_t> m_counts[2];
+    /**
+     * Active copy.
+     */
+    std::atomic<uint32_t> m_active;
+    /**
+     * Guards refreshes.
+     */
+    std::mutex m_mutex;
+
+    code_range_cache()
+        : m_ranges{}
+        , m_counts{}
+        , m_active(0u) {}
+
+  public:
+    code_range_cache(const code_range_cache&) = delete;
+    code_range_cache(code_range_cache&&)      = delete;
+
+    /**
+     * \return Code ranges of the process.
+     */
+    static code_range_cache& instance() {
+        static code_range_cache cache;
+        return cache;
+    }
+
+    /**
+     * Rebuilds the table from loaded modules.
+     *
+     * \return Number of cached ranges.
+     */
+    uint32_t refresh() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        auto next   = m_active.load() ^ 1u;
+        auto ranges = m_ranges[next];
+        auto count  = 0u;
+
+        for (auto& module : loaded_modules()) {
+            image_view image(module.base);
+            auto       section = image.sections();
+
+            for (uint32_t i = 0; i < image.sections_count(); i++, section++) {
+                if (!is_executable_section(*section) ||
+                    (count == kMaxCodeRanges))
+                    continue;
+
+                auto begin = module.base + section->VirtualAddress;
+                ranges[count++] = { begin, begin + get_section_size(*section) };
+            }
+        }
+
+        std::sort(ranges, ranges + count,
+                  [](const code_range& a, const code_range& b) {
+                      return a.begin < b.begin;
+                  });
+
+        m_counts[next].store(count, std::memory_order_relaxed);
+        m_active.store(next, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * \param at Address.
+     * \return Is address in executable code.
+     */
+    bool contains(const uintptr_t at) const {
+        auto active = m_active.load(std::memory_order_acquire);
+        auto count  = m_counts[active].load(std::memory_order_relaxed);
+        auto ranges = m_ranges[active];
+
+        // Last range that starts at or below the address.
+        auto it = std::upper_bound(ranges, ranges + count, at,
+                                   [](const uintptr_t     address,
+                                      const code_range& range) {
+                                       return address < range.begin;
+                                   });
+
+        return (it != ranges) && (at < (it - 1)->end);
+    }
+
+    /**
+     * \return Are ranges cached.
+     */
+    bool empty() const {
+        return !m_counts[m_active.load(std::memory_order_acquire)].load(
+            std::memory_order_relaxed);
+    }
+};   // !class code_range_cache
+
+/**
+ * \return Does the code before the address end with a call.
+ */
+inline bool follows_call(const uintptr_t at) {
+    auto code = reinterpret_cast<const uint8_t*>(at);
+
+    // call rel32
+    if (code[-5] == kCallOpcode)
+        return true;
+
+    // call r/m32: FF /2 with the modrm 2, 3, 6 or 7 bytes back.
+    for (int back : { 2, 3, 6, 7 }) {
+        if ((code[-back] == 0xFF) && ((code[1 - back] & 0x38) == 0x10))
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * \return Bounds of the stack of the current thread.
+ */
+inline code_range current_stack() {
+    auto tib = reinterpret_cast<const NT_TIB*>(NtCurrentTeb());
+    return { reinterpret_cast<uintptr_t>(tib->StackLimit),
+             reinterpret_cast<uintptr_t>(tib->StackBase) };
+}
+}   // namespace detail
+
+/**
+ * Caches executable sections of loaded modules for the stack scan of
+ * \c unwind_stack \c. Call after loading modules, not from hooks.
+ *
+ * \return Number of cached ranges.
+ */
+inline uint32_t refresh_code_ranges() {
+    return detail::code_range_cache::instance().refresh();
+}
+
+/**
+ * Captures return addresses of the caller chain. Walks saved frame
+ * pointers validated against the stack bounds of the thread; when the
+ * chain breaks, scans the stack for values after a call into cached code
+ * ranges. Doesn't allocate or lock.
+ *
+ * \param return_slot Address of the return address of the current
+ * function (\c _AddressOfReturnAddress() \c).
+ * \param out Output return addresses, innermost first.
+ * \param max_depth Size of the output.
+ * \return Number of captured return addresses.
+ */
+inline size_t unwind_stack(const memory_pointer& return_slot, uintptr_t* out,
+                           const size_t max_depth) {
+    auto stack = detail::current_stack();
+    auto slot  = return_slot.addressof();
+
+    if (!max_depth || (slot < stack.begin) ||
+        (slot + sizeof(uintptr_t) > stack.end))
+        return 0u;
+
+    auto&  code  = detail::code_range_cache::instance();
+    size_t depth = 0u;
+
+    out[depth++] = *reinterpret_cast<const uintptr_t*>(slot);
+
+    // The saved frame pointer goes right below the return address.
+    auto frame = *reinterpret_cast<const uintptr_t*>(slot - sizeof(uintptr_t));
+    auto last  = slot;
+
+    while (depth < max_depth) {
+        if (!frame)
+            return depth;
+
+        // Frames grow towards the stack base.
+        if ((frame <= last) || (frame & 3u) ||
+            (frame + 2u * sizeof(uintptr_t) > stack.end))
+            break;
+
+        auto ret = reinterpret_cast<const uintptr_t*>(frame)[1];
+        if (!ret || (!code.empty() && !code.contains(ret)))
+            break;
+
+        out[depth++] = ret;
+        last         = frame + sizeof(uintptr_t);
+        frame        = *reinterpret_cast<const uintptr_t*>(frame);
+    }
+
+    if (code.empty())
+        return depth;
+
+    // Broken chain: scanning above the last valid frame.
+    auto now   = reinterpret_cast<const uintptr_t*>(last) + 1;
+    auto limit = (std::min)(reinterpret_cast<const uintptr_t*>(stack.end),
+                            now + kMaxStackScan);
+
+    for (; (now < limit) && (depth < max_depth); now++) {
+        if (code.contains(*now) && detail::follows_call(*now))
+            out[depth++] = *now;
+    }
+
+    return depth;
+}
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_UNWIND_HPP_
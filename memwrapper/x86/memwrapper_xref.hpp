@@ -0,0 +1,295 @@
+﻿#ifndef MEMWRAPPER_XREF_HPP_
+#define MEMWRAPPER_XREF_HPP_
+
+namespace memwrapper {
+/**
+ * Operand of an instruction that references a string.
+ */
+enum class XrefKind {
+    /**
+     * push imm32, mov r32, imm32, mov r/m32, imm32.
+     */
+    Immediate,
+    /**
+     * Absolute memory operand ([disp32]).
+     */
+    Displacement
+};
+
+/**
+ * @brief Code reference to a string literal.
+ */
+struct string_xref {
+    /**
+     * Address of the string.
+     */
+    uintptr_t string;
+    /**
+     * Address of the referencing instruction.
+     */
+    uintptr_t instruction;
+    /**
+     * Operand that holds the address.
+     */
+    XrefKind kind;
+};   // !struct string_xref
+
+namespace detail {
+/**
+ * Finds every unaligned dword inside [low, high] in a memory block.
+ *
+ * \param begin Start of the block.
+ * \param end End of the block.
+ * \param low Lowest accepted value.
+ * \param high Highest accepted value.
+ * \param found Called with the address of every accepted dword.
+ */
+template<typename Callback>
+inline void scan_dword_range(const uint8_t* begin, const uint8_t* end,
+                             const uint32_t low, const uint32_t high,
+                             Callback&& found) {
+    // Unsigned compare through signed one.
+    const auto bias  = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    const auto lower = _mm_set1_epi32(static_cast<int>(low ^ 0x80000000u));
+    const auto upper = _mm_set1_epi32(static_cast<int>(high ^ 0x80000000u));
+
+    auto now = begin;
+    for (; now + sizeof(__m128i) + 3u <= end; now += sizeof(__m128i)) {
+        // Four loads cover the dwords at every byte offset of the block.
+        for (uint32_t k = 0; k < 4u; k++) {
+            auto block = _mm_xor_si128(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(now + k)),
+                bias);
+            auto outside = _mm_or_si128(_mm_cmplt_epi32(block, lower),
+                                        _mm_cmpgt_epi32(block, upper));
+            auto bits    = ~_mm_movemask_ps(_mm_castsi128_ps(outside)) & 0xF;
+
+            for (uint32_t lane = 0; bits; lane++, bits >>= 1) {
+                if (bits & 1)
+                    found(now + k + lane * sizeof(uint32_t));
+            }
+        }
+    }
+
+    for (; now + sizeof(uint32_t) <= end; now++) {
+        uint32_t value;
+        std::memcpy(&value, now, sizeof(value));
+
+        if ((value >= low) && (value <= high))
+            found(now);
+    }
+}
+
+/**
+ * Finds the instruction that holds a referenced address at \c field \c.
+ *
+ * \param lower Lowest readable address before the field.
+ * \param upper End of readable memory after the field.
+ * \param field Address of the referenced address.
+ * \param instruction Output address of the instruction.
+ * \param kind Output operand kind.
+ * \return Was a referencing instruction found.
+ */
+inline bool decode_xref(const uintptr_t lower, const uintptr_t upper,
+                        const uintptr_t field, uintptr_t& instruction,
+                        XrefKind& kind) {
+    // Longest encoding before disp32: prefix, opcode, modrm and sib.
+    constexpr uint32_t kMaxLookback = 7u;
+
+    for (uint32_t back = 1u; back <= kMaxLookback; back++) {
+        auto start = field - back;
+        if (start < lower)
+            break;
+
+        // Decoding a copy to never read past readable memory.
+        uint8_t code[16]{ 0 };
+        std::memcpy(code, reinterpret_cast<const void*>(start),
+                    (std::min)(upper - start, sizeof(code)));
+
+        hde32s hs;
+        hde32_disasm(code, &hs);
+        if (hs.flags & F_ERROR)
+            continue;
+
+        uint32_t imm_size = ((hs.flags & F_IMM8) ? 1u : 0u) +
+                            ((hs.flags & F_IMM16) ? 2u : 0u) +
+                            ((hs.flags & F_IMM32) ? 4u : 0u);
+
+        if ((hs.flags & F_IMM32) && (back == hs.len - 4u) &&
+            ((hs.opcode == 0x68) || ((hs.opcode & 0xF8) == 0xB8) ||
+             (hs.opcode == 0xC7))) {
+            instruction = start;
+            kind        = XrefKind::Immediate;
+            return true;
+        }
+
+        if ((hs.flags & F_DISP32) && (hs.flags & F_MODRM) &&
+            (hs.modrm_mod == 0) && (back == hs.len - imm_size - 4u)) {
+            instruction = start;
+            kind        = XrefKind::Displacement;
+            return true;
+        }
+    }
+
+    return false;
+}
+}   // namespace detail
+
+/**
+ * Finds code references to many string literals in one sweep.
+ *
+ * Literals (with the terminating zero) are searched in read-only data
+ * sections, then executable sections are swept once for any dword that
+ * equals one of their addresses. Every hit is validated by decoding the
+ * instruction around it.
+ *
+ * \param handle Module to search in.
+ * \param texts String literals.
+ * \return References of every literal sorted by instruction address.
+ */
+inline std::vector<std::vector<string_xref>>
+find_strings_xrefs(const HMODULE                        handle,
+                   const std::vector<std::string_view>& texts) {
+    struct chunk {
+        uintptr_t begin;
+        uintptr_t end;
+        uintptr_t lower;
+        uintptr_t upper;
+    };
+
+    std::vector<std::vector<string_xref>> result(texts.size());
+
+    image_view image(handle);
+    if (!image.good() || texts.empty())
+        return result;
+
+    pattern_set           patterns;
+    std::vector<uint32_t> owners;
+    for (uint32_t i = 0; i < texts.size(); i++) {
+        std::string literal(texts[i]);
+        literal.push_back('\0');
+
+        if (patterns.add(literal, std::string(literal.size(), 'x')) >= 0)
+            owners.push_back(i);
+    }
+
+    auto base    = image.base().addressof();
+    auto section = image.sections();
+
+    std::vector<chunk> data_chunks, code_chunks;
+    for (uint32_t i = 0; i < image.sections_count(); i++, section++) {
+        auto begin = base + section->VirtualAddress;
+        auto end   = begin + detail::get_section_size(*section);
+
+        std::vector<chunk>* chunks = nullptr;
+        if (detail::is_executable_section(*section))
+            chunks = &code_chunks;
+        else if ((section->Characteristics & IMAGE_SCN_MEM_READ) &&
+                 !(section->Characteristics & IMAGE_SCN_MEM_WRITE))
+            chunks = &data_chunks;
+
+        if (!chunks)
+            continue;
+
+        for (auto now = begin; now < end; now += kScanChunkSize)
+            chunks->push_back(
+                { now, (std::min)(end, now + kScanChunkSize), begin, end });
+    }
+
+    // Locating the literals.
+    std::vector<std::vector<std::pair<uint32_t, uint32_t>>> found(
+        data_chunks.size());
+
+    detail::worker_pool::instance().parallel_for(
+        data_chunks.size(), [&](const size_t index) {
+            auto& now = data_chunks[index];
+            auto  end = (std::min)(now.upper, now.end + patterns.max_length());
+
+            patterns.scan(reinterpret_cast<const uint8_t*>(now.begin),
+                          reinterpret_cast<const uint8_t*>(end),
+                          [&](const uint32_t pattern, const uintptr_t at) {
+                              // Overlapped matches belong to the next chunk.
+                              if (at < now.end)
+                                  found[index].push_back(
+                                      { static_cast<uint32_t>(at),
+                                        owners[pattern] });
+                          });
+        });
+
+    std::vector<std::pair<uint32_t, uint32_t>> targets;
+    for (auto& now : found)
+        targets.insert(targets.end(), now.begin(), now.end());
+
+    if (targets.empty())
+        return result;
+
+    std::sort(targets.begin(), targets.end());
+
+    // Sweeping the code for the addresses.
+    auto low  = targets.front().first;
+    auto high = targets.back().first;
+
+    std::vector<std::vector<std::pair<uint32_t, string_xref>>> hits(
+        code_chunks.size());
+
+    detail::worker_pool::instance().parallel_for(
+        code_chunks.size(), [&](const size_t index) {
+            auto& now = code_chunks[index];
+            auto  end = (std::min)(now.upper, now.end + sizeof(uint32_t) - 1u);
+
+            detail::scan_dword_range(
+                reinterpret_cast<const uint8_t*>(now.begin),
+                reinterpret_cast<const uint8_t*>(end), low, high,
+                [&](const uint8_t* at) {
+                    uint32_t value;
+                    std::memcpy(&value, at, sizeof(value));
+
+                    auto range = std::equal_range(
+                        targets.begin(), targets.end(),
+                        std::make_pair(value, 0u),
+                        [](const std::pair<uint32_t, uint32_t>& a,
+                           const std::pair<uint32_t, uint32_t>& b) {
+                            return a.first < b.first;
+                        });
+                    if (range.first == range.second)
+                        return;
+
+                    string_xref xref{ value, 0u, XrefKind::Immediate };
+                    if (!detail::decode_xref(now.lower, now.upper,
+                                             reinterpret_cast<uintptr_t>(at),
+                                             xref.instruction, xref.kind))
+                        return;
+
+                    for (auto it = range.first; it != range.second; ++it)
+                        hits[index].push_back({ it->second, xref });
+                });
+        });
+
+    for (auto& now : hits) {
+        for (auto& hit : now)
+            result[hit.first].push_back(hit.second);
+    }
+
+    for (auto& xrefs : result)
+        std::sort(xrefs.begin(), xrefs.end(),
+                  [](const string_xref& a, const string_xref& b) {
+                      return a.instruction < b.instruction;
+                  });
+
+    return result;
+}
+
+/**
+ * Finds code references to a string literal.
+ *
+ * \param handle Module to search in.
+ * \param text String literal.
+ * \return References sorted by instruction address.
+ */
+inline std::vector<string_xref> find_string_xrefs(const HMODULE    handle,
+                                                  std::string_view text) {
+    return find_strings_xrefs(handle, { text }).front();
+}
+}   // namespace memwrapper
+
+#endif   // !MEMWRAPPER_XREF_HPP_